@@ -0,0 +1,15 @@
+.section ".text"
+
+.global task_switch
+.type task_switch, %function
+
+// void task_switch(uintptr_t* save_sp, uintptr_t next_sp)
+// Empilha os registradores preservados pela chamada (r4-r11) e o endereço
+// de retorno, guarda sp em *save_sp e desempilha o quadro da outra tarefa.
+// O build não usa a VFP, então não há registradores de ponto flutuante.
+task_switch:
+    push {r4-r11, lr}
+    str sp, [r0]
+    mov sp, r1
+    pop {r4-r11, lr}
+    bx lr
@@ -0,0 +1,133 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include <stdint.h>
+#include "task.h"
+
+/*
+ * Operações atômicas sobre palavras de 32 bits.
+ *
+ * No alvo (ARMv7 e AArch64) o kernel roda com a MMU e a cache de dados
+ * desligadas, e toda a RAM é memória Strongly-ordered/Device, para a qual o
+ * BCM2836/7 não tem monitor exclusivo global: um STREX ou STLXR pode falhar
+ * para sempre. Como há um só núcleo e as tarefas são cooperativas, a
+ * leitura-modificação-escrita é comum, feita com as IRQs mascaradas (a do
+ * profiler é a única que pode interrompê-la). Em um build para o host usam
+ * os builtins __atomic do GCC, que seguem o modelo de memória do C11.
+ */
+
+#if defined(__arm__)
+
+// Mascara as IRQs e devolve o CPSR anterior
+static inline uint32_t irq_save() {
+    uint32_t cpsr;
+    asm volatile("mrs %0, cpsr\n\tcpsid i" : "=r"(cpsr) :: "memory");
+    return cpsr;
+}
+
+// Desmascara as IRQs se elas estavam liberadas em irq_save (bit I do CPSR)
+static inline void irq_restore(uint32_t cpsr) {
+    if (!(cpsr & 0x80)) asm volatile("cpsie i" ::: "memory");
+}
+
+#define ATOMIC_IRQ_MASKED
+
+#elif defined(__aarch64__)
+
+// Mascara as IRQs e devolve o DAIF anterior
+static inline uint64_t irq_save() {
+    uint64_t daif;
+    asm volatile("mrs %0, daif\n\tmsr daifset, #2" : "=r"(daif) :: "memory");
+    return daif;
+}
+
+static inline void irq_restore(uint64_t daif) {
+    asm volatile("msr daif, %0" :: "r"(daif) : "memory");
+}
+
+#define ATOMIC_IRQ_MASKED
+
+#endif
+
+#ifdef ATOMIC_IRQ_MASKED
+
+static inline int atomic_cas32(volatile uint32_t* p, uint32_t expected, uint32_t desired) {
+    uintptr_t flags = irq_save();
+    int ok = *p == expected;
+    if (ok) *p = desired;
+    irq_restore(flags);
+    return ok;
+}
+
+static inline uint32_t atomic_fetch_or32(volatile uint32_t* p, uint32_t mask) {
+    uintptr_t flags = irq_save();
+    uint32_t old = *p;
+    *p = old | mask;
+    irq_restore(flags);
+    return old;
+}
+
+static inline uint32_t atomic_fetch_and32(volatile uint32_t* p, uint32_t mask) {
+    uintptr_t flags = irq_save();
+    uint32_t old = *p;
+    *p = old & mask;
+    irq_restore(flags);
+    return old;
+}
+
+static inline uint32_t atomic_fetch_add32(volatile uint32_t* p, uint32_t value) {
+    uintptr_t flags = irq_save();
+    uint32_t old = *p;
+    *p = old + value;
+    irq_restore(flags);
+    return old;
+}
+
+static inline void cpu_relax() {
+    asm volatile("yield" ::: "memory");
+}
+
+#else
+
+static inline int atomic_cas32(volatile uint32_t* p, uint32_t expected, uint32_t desired) {
+    return __atomic_compare_exchange_n(p, &expected, desired, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static inline uint32_t atomic_fetch_or32(volatile uint32_t* p, uint32_t mask) {
+    return __atomic_fetch_or(p, mask, __ATOMIC_ACQ_REL);
+}
+
+static inline uint32_t atomic_fetch_and32(volatile uint32_t* p, uint32_t mask) {
+    return __atomic_fetch_and(p, mask, __ATOMIC_ACQ_REL);
+}
+
+static inline uint32_t atomic_fetch_add32(volatile uint32_t* p, uint32_t value) {
+    return __atomic_fetch_add(p, value, __ATOMIC_ACQ_REL);
+}
+
+static inline void cpu_relax() {
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif
+
+// Spinlock simples: 0 = livre, 1 = ocupado. Quem segura o lock pode ser
+// uma tarefa que cedeu o processador (task.h): a espera também cede, para
+// que ela possa terminar.
+typedef struct {
+    volatile uint32_t locked;
+} Spinlock;
+
+static inline void spin_lock(Spinlock* l) {
+    while (!atomic_cas32(&l->locked, 0, 1)) {
+        cpu_relax();
+        task_yield();
+    }
+}
+
+static inline void spin_unlock(Spinlock* l) {
+    atomic_fetch_and32(&l->locked, 0);
+}
+
+#endif
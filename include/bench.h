@@ -0,0 +1,42 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+// Diretório de rascunho criado (e removido) no diretório atual
+#define BENCH_DIR "bench.tmp"
+
+#define BENCH_DEFAULT_FILES 256
+#define BENCH_MAX_FILES 4096
+
+#define BENCH_FLASH_DEFAULT_ROUNDS 200
+#define BENCH_FLASH_MAX_ROUNDS 1000
+
+/**
+ * @brief Executa a suíte de microbenchmarks do sistema de arquivos.
+ * * Em um diretório de rascunho: criação de 'files' arquivos, buscas com
+ * acerto e com falha (find_entry), listagens, escrita por anexação até o
+ * tamanho máximo de arquivo, leitura sequencial e remoção. Por fim, mede
+ * a formatação e a montagem sobre uma cópia do disco guardada no heap,
+ * que é restaurada em seguida. As mensagens das operações são suprimidas
+ * e os tempos vêm do System Timer. Cada resultado sai em uma linha
+ * "BENCH <nome> chave=valor ...", lida por tools/benchcmp.py.
+ * @param files O número de arquivos (1 a BENCH_MAX_FILES).
+ * @return 0 em caso de sucesso, -1 se uma etapa falhar.
+ */
+int fs_bench(uint32_t files);
+
+/**
+ * @brief Compara os layouts inplace e log do dispositivo flash (flash.h).
+ * * Partindo do mesmo disco, executa para cada layout uma carga de
+ * anexações e remoções em um diretório de rascunho, sincronizando com o
+ * dispositivo a intervalos regulares, e imprime uma linha "BENCH
+ * flash_<layout>" com os blocos lógicos e físicos escritos, as requisições,
+ * a amplificação de escrita (wa_x100) e a vazão pelo modelo de custo do
+ * dispositivo. O disco e o layout anterior são restaurados ao final.
+ * @param rounds O número de rodadas (1 a BENCH_FLASH_MAX_ROUNDS).
+ * @return 0 em caso de sucesso, -1 se uma etapa falhar.
+ */
+int fs_bench_flash(uint32_t rounds);
+
+#endif
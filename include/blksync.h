@@ -0,0 +1,64 @@
+#ifndef BLKSYNC_H
+#define BLKSYNC_H
+
+#include <stdint.h>
+
+// Fluxo de exportação: "SFSX", versão 1, terminado por "SFSE"
+#define BLKSYNC_MAGIC   0x58534653
+#define BLKSYNC_END     0x45534653
+#define BLKSYNC_VERSION 1
+
+// Depois do magic, um fluxo que fica esse tempo sem nenhum byte é abandonado
+#define BLKSYNC_TIMEOUT_US 2000000
+
+/*
+ * Formato do fluxo (palavras de 32 bits, little-endian):
+ *   cabeçalho  magic, versão, BLOCK_SIZE, total de blocos, checkpoint
+ *              base (0 = imagem completa), novo checkpoint, registros
+ *   registro   número do bloco, BLOCK_SIZE bytes de dados e o CRC-32 do
+ *              número do bloco seguido dos dados
+ *   final      BLKSYNC_END
+ * Ver tools/blksync.py.
+ */
+
+/**
+ * @brief Registra que um bloco mudou desde o último checkpoint.
+ * * Chamada pela camada de blocos (write_block, mark_dirty e afins). O
+ * mapa de blocos alterados fica em .noinit, junto com o disco, e
+ * sobrevive a uma reinicialização a quente.
+ * @param block_num O bloco alterado.
+ */
+void blksync_mark(uint32_t block_num);
+
+/**
+ * @brief Valida o mapa de blocos alterados na montagem.
+ * * Se ele não sobreviveu (boot a frio), todos os blocos passam a contar
+ * como alterados e a sequência de checkpoints recomeça.
+ */
+void blksync_mount();
+
+/**
+ * @brief Envia pela UART os blocos em uso alterados desde o último
+ * checkpoint e inicia um novo checkpoint.
+ * @param full 1 para enviar todos os blocos em uso (imagem completa).
+ * @return O número de blocos enviados.
+ */
+uint32_t blksync_export(int full);
+
+/**
+ * @brief Recebe pela UART um fluxo de exportação e o aplica ao disco.
+ * * Todos os registros são recebidos e conferidos antes de qualquer
+ * escrita; um fluxo com erro não altera o disco. Um fluxo incremental só
+ * é aceito se partir do checkpoint atual do disco. O sistema de arquivos
+ * é remontado em seguida. Um fluxo interrompido (BLKSYNC_TIMEOUT_US sem
+ * nenhum byte) é abandonado sem alterar o disco.
+ * @return O número de blocos aplicados, ou -1 em caso de erro.
+ */
+int blksync_import();
+
+/**
+ * @brief Mostra o checkpoint atual e quantos blocos mudaram desde ele.
+ */
+void blksync_stat();
+
+#endif
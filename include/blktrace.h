@@ -0,0 +1,69 @@
+#ifndef BLKTRACE_H
+#define BLKTRACE_H
+
+#include <stdint.h>
+
+#define BLKTRACE_READ  0
+#define BLKTRACE_WRITE 1
+
+#ifdef CONFIG_BLKTRACE
+
+// Capacidade do buffer circular (potência de 2)
+#define BLKTRACE_ENTRIES 4096
+
+// Cabeçalho do dump binário: "BTRC", versão 1
+#define BLKTRACE_MAGIC   0x43525442
+#define BLKTRACE_VERSION 1
+
+/*
+ * Registro compacto de 8 bytes (little-endian):
+ *   timestamp  microssegundos do System Timer
+ *   info       bits 0-23: bloco, bits 24-30: operação chamadora
+ *              (enum perf_op), bit 31: 1 = escrita, 0 = leitura
+ */
+typedef struct {
+    uint32_t timestamp;
+    uint32_t info;
+} BlkTraceRecord;
+
+// Operação do sistema de arquivos em execução (mantida por PERF_SCOPE)
+extern uint32_t blktrace_current_op;
+
+/**
+ * @brief Registra um acesso a bloco no buffer circular, se a gravação estiver ativa.
+ * @param block_num O número do bloco acessado.
+ * @param rw BLKTRACE_READ ou BLKTRACE_WRITE.
+ */
+void blktrace_record(uint32_t block_num, uint32_t rw);
+
+/**
+ * @brief Liga ou desliga a gravação de acessos.
+ * @param enabled 1 para gravar, 0 para pausar.
+ */
+void blktrace_enable(int enabled);
+
+/**
+ * @brief Descarta todos os registros do buffer.
+ */
+void blktrace_clear();
+
+/**
+ * @brief Mostra o estado do gravador e a contagem de acessos por operação.
+ */
+void blktrace_stat();
+
+/**
+ * @brief Envia o conteúdo do buffer em formato binário pela UART.
+ * * O fluxo é: magic, versão, número de registros, primeiro bloco de
+ * dados e total de blocos (5 palavras de 32 bits), seguidos pelos
+ * registros do mais antigo ao mais recente. Ver tools/blkreplay.py.
+ */
+void blktrace_dump();
+
+#else
+
+#define blktrace_record(block_num, rw) ((void)0)
+
+#endif
+
+#endif
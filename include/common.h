@@ -47,6 +47,26 @@ void* memcpy(void *dest, const void *src, uint32_t n);
  */
 void* memset(void *s, int c, uint32_t n);
 
+/**
+ * @brief Compara dois blocos de memória byte a byte.
+ * @param s1 O primeiro bloco.
+ * @param s2 O segundo bloco.
+ * @param n O número de bytes a comparar.
+ * @return 0 se os blocos forem iguais, outro valor caso contrário.
+ */
+int memcmp(const void *s1, const void *s2, uint32_t n);
+
+/**
+ * @brief Procura a primeira ocorrência de um byte em um bloco de memória.
+ * * Compara uma palavra nativa por vez (4 ou 8 bytes) depois de alinhar o
+ * ponteiro, e só volta ao byte a byte na palavra que contém o byte.
+ * @param s O bloco.
+ * @param c O byte procurado (convertido para unsigned char).
+ * @param n O tamanho do bloco.
+ * @return Um ponteiro para a ocorrência, ou NULL se não houver.
+ */
+void* memchr(const void *s, int c, uint32_t n);
+
 /**
  * @brief Concatena a string de origem ao final da string de destino.
  * @param dest A string de destino.
@@ -62,4 +82,23 @@ char* strcat(char *dest, const char *src);
  */
 void itoa(int n, char* buffer);
 
+/**
+ * @brief Converte uma string decimal em um inteiro sem sinal.
+ * @param s A string (só dígitos).
+ * @param value Recebe o número convertido.
+ * @return 0 em caso de sucesso, -1 se a string for vazia, tiver outros
+ * caracteres ou não couber em 32 bits.
+ */
+int parse_uint(const char* s, uint32_t* value);
+
+/**
+ * @brief Divide dois inteiros sem sinal.
+ * * O build não liga com a libgcc, então divisões por valores não
+ * constantes devem usar esta função em vez do operador '/'.
+ * @param n O dividendo.
+ * @param d O divisor (não nulo).
+ * @return O quociente n / d.
+ */
+uint32_t udiv32(uint32_t n, uint32_t d);
+
 #endif
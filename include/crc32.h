@@ -0,0 +1,19 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+
+/**
+ * @brief Calcula o CRC-32 (polinômio 0x04C11DB7 refletido, o mesmo do zlib).
+ * * Com ARCH=armv8-a o build habilita a extensão CRC do Cortex-A53 e o
+ * cálculo usa as instruções CRC32W/CRC32B, uma palavra por instrução; no
+ * armv7-a são usadas tabelas "slice-by-4", quatro bytes por passo. Os dois
+ * caminhos produzem o mesmo resultado.
+ * @param crc O CRC acumulado até aqui (0 para começar um cálculo novo).
+ * @param data Os dados.
+ * @param len O número de bytes.
+ * @return O CRC acumulado incluindo 'data'.
+ */
+uint32_t crc32(uint32_t crc, const void* data, uint32_t len);
+
+#endif
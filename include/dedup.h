@@ -0,0 +1,72 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <stdint.h>
+
+// Entrada da tabela de referências (uma por bloco, no disco): o bit alto
+// marca um bloco de dados indexado, cujo fingerprint é o CRC-32 guardado na
+// tabela de checksums; os 31 bits baixos contam os donos além do primeiro.
+#define REF_INDEXED    0x80000000
+#define REF_COUNT_MASK 0x7FFFFFFF
+
+/**
+ * @brief Liga ou desliga a deduplicação nas próximas escritas.
+ * * Os blocos já compartilhados continuam válidos com ela desligada.
+ * @param enabled 1 para ligar, 0 para desligar.
+ */
+void dedup_set_enabled(int enabled);
+
+/**
+ * @brief Informa se a deduplicação está ligada.
+ * @return 1 se ligada, 0 caso contrário.
+ */
+int dedup_enabled();
+
+/**
+ * @brief Reconstrói o índice de fingerprints em memória a partir da tabela
+ * de referências do disco. Chamada na montagem; refaz a alocação se o
+ * disco mudou de tamanho.
+ */
+void dedup_mount();
+
+/**
+ * @brief Tenta compartilhar um bloco cheio antes de escrevê-lo.
+ * * Calcula o fingerprint de 'data' e procura no índice um bloco idêntico
+ * (confirmado byte a byte). Se achar, o bloco 'index' do inode passa a
+ * apontar para ele e ganha uma referência. O chamador deve manter o lock
+ * do inode. Com a deduplicação desligada, não faz nada.
+ * @param inode_num O inode do arquivo.
+ * @param index O índice do bloco dentro do arquivo.
+ * @param data O conteúdo do bloco (BLOCK_SIZE bytes).
+ * @param fp Recebe o fingerprint calculado (0 se nenhum), para dedup_seal.
+ * @return 1 se o bloco foi compartilhado, 0 se deve ser escrito normalmente.
+ */
+int dedup_share(uint32_t inode_num, uint32_t index, const void* data, uint32_t* fp);
+
+/**
+ * @brief Indexa um bloco de arquivo que acabou de ficar cheio.
+ * * Blocos cheios não mudam mais (as escritas só anexam), então podem ser
+ * compartilhados. Se o bloco for idêntico a um já indexado, o arquivo
+ * passa a usar o outro e o seu é liberado. Com a deduplicação desligada,
+ * não faz nada.
+ * @param inode_num O inode do arquivo.
+ * @param index O índice do bloco dentro do arquivo.
+ * @param block_num O bloco recém-preenchido.
+ * @param fp O fingerprint devolvido por dedup_share, ou 0 para calculá-lo.
+ */
+void dedup_seal(uint32_t inode_num, uint32_t index, uint32_t block_num, uint32_t fp);
+
+/**
+ * @brief Retira uma referência de um bloco que está sendo liberado.
+ * @param block_num O bloco.
+ * @return 1 se o bloco ainda tem outros donos e não deve ser liberado.
+ */
+int dedup_unref(uint32_t block_num);
+
+/**
+ * @brief Mostra as linhas da deduplicação em fs_stat.
+ * @param used_blocks Blocos de dados ocupados no disco (espaço físico).
+ */
+void dedup_stat(uint32_t used_blocks);
+
+#endif
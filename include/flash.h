@@ -0,0 +1,131 @@
+#ifndef FLASH_H
+#define FLASH_H
+
+#include <stdint.h>
+#include "fs_defs.h"
+
+/*
+ * Modelo de um dispositivo flash por trás do disco em RAM. O disco continua
+ * sendo a cópia de trabalho (um cache de escrita); flash_sync grava no
+ * dispositivo os blocos alterados, com um de dois layouts:
+ *   inplace  cada bloco lógico tem um endereço fixo no dispositivo
+ *   log      os blocos são anexados a segmentos sequenciais, cada grupo
+ *            precedido de um resumo com os números lógicos; um mapa
+ *            lógico -> físico vai para um checkpoint periódico e um
+ *            limpador compacta os segmentos com poucos blocos vivos
+ * O dispositivo fica no heap e some com o layout "off" ou no reboot.
+ */
+#define FLASH_OFF     0
+#define FLASH_INPLACE 1
+#define FLASH_LOG     2
+
+// Layout log: segmentos de 32 KB somando 25% a mais que o disco (160 com
+// o disco padrão, para o limpador), mais os dois checkpoints
+#define FLASH_SEGMENT_BLOCKS 64
+#define FLASH_MAX_SEGMENTS   (DISK_MAX_BLOCKS / FLASH_SEGMENT_BLOCKS * 5 / 4 + 32)
+
+// Segmentos escritos entre dois checkpoints do mapa, por segmento ocupado
+// por um checkpoint: o custo do checkpoint fica proporcional ao disco
+#define FLASH_CHECKPOINT_EVERY 8
+
+// Com menos de FLASH_CLEAN_LOW segmentos livres, a escrita espera o limpador
+// chegar a FLASH_CLEAN_HIGH; abaixo disso, ele roda em segundo plano enquanto
+// o shell espera por comandos
+#define FLASH_CLEAN_LOW  4
+#define FLASH_CLEAN_HIGH 16
+
+// Custo estimado de cada escrita no dispositivo: latência por requisição
+// (uma sequência de blocos contíguos) mais a transferência de cada bloco,
+// na ordem de um cartão SD classe 10 escrevendo ao acaso
+#define FLASH_REQUEST_US 250
+#define FLASH_BLOCK_US   25
+
+typedef struct {
+    uint32_t logical;            // Blocos lógicos gravados por flash_sync
+    uint32_t device_writes;      // Blocos escritos no dispositivo
+    uint32_t requests;           // Sequências contíguas de escrita
+    uint32_t device_reads;       // Blocos lidos pelo limpador
+    uint32_t summaries;          // Blocos de resumo de segmento
+    uint32_t checkpoint_blocks;  // Blocos escritos pelos checkpoints
+    uint32_t cleaned_segments;   // Segmentos esvaziados pelo limpador
+    uint32_t relocated;          // Blocos vivos copiados pelo limpador
+} FlashStats;
+
+/**
+ * @brief Registra que um bloco mudou desde a última sincronização.
+ * * Chamada pela camada de blocos; sem layout, não faz nada.
+ * @param block_num O bloco alterado.
+ */
+void flash_mark(uint32_t block_num);
+
+/**
+ * @brief Troca o layout do dispositivo.
+ * * O dispositivo anterior é descartado e o novo recebe uma cópia dos
+ * blocos em uso (não contada nas estatísticas, que recomeçam).
+ * @param layout FLASH_OFF, FLASH_INPLACE ou FLASH_LOG.
+ * @return 0 em caso de sucesso, -1 sem memória para o dispositivo.
+ */
+int flash_set_layout(int layout);
+
+/**
+ * @brief Refaz o dispositivo, no mesmo layout, se o disco mudou de tamanho
+ * desde a troca de layout.
+ * * Chamada por fs_format e fs_mount: o dispositivo, o mapa e os segmentos
+ * são dimensionados por sb.total_blocks. Sem memória, o layout é desligado.
+ */
+void flash_resize();
+
+/**
+ * @brief Informa o layout atual.
+ * @return FLASH_OFF, FLASH_INPLACE ou FLASH_LOG.
+ */
+int flash_layout();
+
+/**
+ * @brief Grava no dispositivo os blocos em uso alterados desde a última
+ * sincronização. Blocos liberados saem do mapa do layout log (como um TRIM).
+ * @return O número de blocos lógicos gravados.
+ */
+uint32_t flash_sync();
+
+/**
+ * @brief Trabalho em segundo plano, chamado enquanto o shell espera por
+ * entrada: limpa um segmento se houver menos de FLASH_CLEAN_HIGH livres.
+ */
+void flash_idle();
+
+/**
+ * @brief Limpa segmentos (e grava um checkpoint) até haver 'target' livres.
+ * @param target O número de segmentos livres desejado.
+ * @return O número de segmentos esvaziados.
+ */
+uint32_t flash_clean(uint32_t target);
+
+/**
+ * @brief Remonta o mapa como na recuperação após uma queda (último
+ * checkpoint válido mais os resumos escritos depois dele) e compara cada
+ * bloco em uso com o disco em RAM. Chame flash_sync antes.
+ * @return O número de blocos divergentes ou ausentes, ou -1 se não houver
+ * um checkpoint válido (ou o layout não for log).
+ */
+int flash_verify();
+
+/**
+ * @brief Copia as estatísticas acumuladas desde a troca de layout.
+ * @param out Recebe as estatísticas.
+ */
+void flash_get_stats(FlashStats* out);
+
+/**
+ * @brief Tempo estimado do dispositivo para as escritas registradas.
+ * @param stats As estatísticas, como em flash_get_stats.
+ * @return O tempo em microssegundos, pelo modelo FLASH_REQUEST_US/FLASH_BLOCK_US.
+ */
+uint32_t flash_model_us(const FlashStats* stats);
+
+/**
+ * @brief Mostra o layout, a amplificação de escrita e o estado do log.
+ */
+void flash_stat();
+
+#endif
@@ -5,14 +5,55 @@
 
 // Configurações
 #define BLOCK_SIZE 512
-#define MAX_FILENAME_LEN 28
-#define NUM_INODES 128
-#define NUM_DATA_BLOCKS 8192  // 8192 * 512 bytes = 4MB
+#define MAX_FILENAME_LEN 255
+#define MAX_PATH_LEN 1024
+#define NUM_INODES 2048
 #define MAX_DIRECT_POINTERS 12
-#define FS_MAGIC 0x5346534A    // "SFSJ" em ASCII
+#define FS_MAGIC 0x53465332    // "SFS2" em ASCII (tabela de referências de 32 bits)
 #define ATTR_FILE 1
 #define ATTR_DIRECTORY 2
 
+// Ponteiros em um bloco indireto e tamanho máximo de um arquivo, em blocos
+#define POINTERS_PER_BLOCK (BLOCK_SIZE / sizeof(uint32_t))
+#define MAX_FILE_BLOCKS (MAX_DIRECT_POINTERS + POINTERS_PER_BLOCK)
+
+// Tamanho do disco em RAM, em blocos. A formatação usa a capacidade definida
+// no boot (fs_set_capacity), a partir da memória informada pelo firmware;
+// a montagem usa o total do superbloco (sb.total_blocks).
+#define DISK_DEFAULT_BLOCKS 8192    // 4 MB, sem a resposta do firmware
+#define DISK_MAX_BLOCKS 2031616     // 992 MB: o 1 GB do Pi 3 acima de .noinit
+
+// Palavras de um bitmap com um bit por bloco, no maior disco possível
+#define DISK_BITMAP_WORDS ((DISK_MAX_BLOCKS + 31) / 32)
+
+// Número de blocos ocupados pelo bitmap de inodes (1 bit por inode)
+#define INODE_BITMAP_BLOCKS ((NUM_INODES + BLOCK_SIZE * 8 - 1) / (BLOCK_SIZE * 8))
+
+// Número de blocos ocupados pelo bitmap de dados de um disco de 'n' blocos
+// (1 bit por bloco)
+#define DATA_BITMAP_BLOCKS(n) (((n) + BLOCK_SIZE * 8 - 1) / (BLOCK_SIZE * 8))
+
+// Número de blocos da tabela de referências da deduplicação (32 bits por bloco)
+#define REFCOUNT_TABLE_BLOCKS(n) (((n) * 4 + BLOCK_SIZE - 1) / BLOCK_SIZE)
+
+// Número de blocos da tabela de checksums (um CRC-32 por bloco do disco)
+#define CSUM_TABLE_BLOCKS(n) (((n) * 4 + BLOCK_SIZE - 1) / BLOCK_SIZE)
+
+// Opções de montagem
+#define MOUNT_CHECK  0x1       // Executa o fsck durante a montagem
+#define MOUNT_REPAIR 0x2       // Corrige as inconsistências encontradas pelo fsck
+#define MOUNT_DEFAULT_OPTS 0
+
+// Opções da montagem no boot: make FSCK=1 verifica o disco, FSCK=repair
+// também corrige
+#if defined(CONFIG_MOUNT_REPAIR)
+#define MOUNT_BOOT_OPTS (MOUNT_CHECK | MOUNT_REPAIR)
+#elif defined(CONFIG_MOUNT_CHECK)
+#define MOUNT_BOOT_OPTS MOUNT_CHECK
+#else
+#define MOUNT_BOOT_OPTS MOUNT_DEFAULT_OPTS
+#endif
+
 // Estruturas
 
 typedef struct {
@@ -23,32 +64,153 @@ typedef struct {
     uint32_t inode_table_start_block;
     uint32_t data_area_start_block;
     uint32_t root_inode_number;
+    uint32_t csum_table_start_block;
+    uint32_t refcount_table_start_block;
+    uint32_t checksum;          // CRC-32 do superbloco, calculado com este campo zerado
 } Superblock;
 
 typedef struct {
     uint8_t type;  // 1 = arquivo, 2 = diretório
-    uint32_t size;
+    uint32_t size; // Diretórios: blocos alocados * BLOCK_SIZE
     uint32_t direct_pointers[MAX_DIRECT_POINTERS];
+    uint32_t indirect_pointer;  // Bloco com mais POINTERS_PER_BLOCK ponteiros
 } Inode;
 
+/*
+ * Entrada de diretório de tamanho variável. As entradas de um bloco formam
+ * uma lista contínua: rec_len leva da entrada à seguinte, e a última vai até
+ * o fim do bloco. O espaço além de DIRENT_SIZE(name_len) é livre e pode
+ * receber uma nova entrada; uma entrada com name_len 0 está vazia. O nome
+ * não é terminado em nulo.
+ */
 typedef struct {
-    char filename[MAX_FILENAME_LEN];
     uint32_t inode_number;
+    uint16_t rec_len;
+    uint8_t name_len;
+    uint8_t type;               // ATTR_FILE ou ATTR_DIRECTORY
+    char name[];
 } DirectoryEntry;
 
+// Tamanho ocupado por uma entrada com um nome de 'len' bytes (múltiplo de 4)
+#define DIRENT_HEADER_SIZE 8
+#define DIRENT_SIZE(len) ((DIRENT_HEADER_SIZE + (len) + 3) & ~3u)
+
+// Contexto de execução: cada contexto tem seu próprio diretório de trabalho
+typedef struct {
+    uint32_t cwd_inode;
+    char cwd_path[MAX_PATH_LEN];
+} FsContext;
+
+// Em um build para o host cada thread tem o seu ponteiro de contexto; no
+// alvo, quem troca de contexto de execução troca também fs_ctx.
+#if __STDC_HOSTED__
+#define FS_CONTEXT_LOCAL _Thread_local
+#else
+#define FS_CONTEXT_LOCAL
+#endif
+
 extern Superblock sb;
 extern uint32_t *inode_bitmap;
 extern uint32_t *data_bitmap;
 extern Inode *inode_table;
+extern uint32_t *csum_table;
+extern uint32_t *refcount_table;
+extern uint32_t csum_errors;
 extern void *data_area;
-extern uint32_t current_dir_inode_num;
-extern char current_path_string[256];
+extern FS_CONTEXT_LOCAL FsContext *fs_ctx;
 
 void read_block(uint32_t block_num, void* buffer);
 void write_block(uint32_t block_num, const void* buffer);
+
+// Mapeamento de blocos sem cópia: get_block devolve um ponteiro para o bloco
+// no próprio backend (a RAM, aqui; o cache, em outros). Quem alterar o bloco
+// chama mark_dirty antes de put_block, que encerra o mapeamento.
+//
+// Blocos de metadados (bitmaps, tabela de inodes e diretórios) têm CRC-32 na
+// tabela de checksums: get_block o verifica na primeira leitura após a
+// montagem e devolve NULL se não conferir, e a escrita usa mark_dirty_meta,
+// que o recalcula. A entrada 0 indica um bloco
+// sem checksum (dados de arquivo).
+void* get_block(uint32_t block_num);
+void* get_block_unverified(uint32_t block_num);
+void mark_dirty(uint32_t block_num);
+void mark_dirty_meta(uint32_t block_num);
+void mark_inode_dirty(uint32_t inode_num);
+int block_csum_ok(uint32_t block_num);
+void csum_set(uint32_t block_num, uint32_t csum);
+void csum_rebuild_meta();
+uint32_t csum_verify_meta();
+void put_block(uint32_t block_num);
 void set_bitmap_bit(uint32_t* bitmap, uint32_t index);
 void clear_bitmap_bit(uint32_t* bitmap, uint32_t index);
-int find_free_inode();
-int find_free_data_block();
+
+// Zera os bits [start, start + count), uma palavra do bitmap por vez
+void bitmap_clear_range(uint32_t* bitmap, uint32_t start, uint32_t count);
+
+// Alocação sem locks: reserva atomicamente o primeiro bit livre (-1 se cheio)
+int alloc_inode();
+int alloc_data_block();
+void free_inode(uint32_t inode_num);
+void free_data_block(uint32_t block_num);
+
+// Libera de uma vez 'count' blocos contíguos a partir de 'start'
+void free_data_blocks(uint32_t start, uint32_t count);
+
+// Com o superbloco inválido na montagem, o disco fica somente para leitura:
+// fs_check_writable avisa e retorna -1, e as operações que gravam desistem.
+// superblock_check compara o superbloco gravado com o montado (e o seu
+// checksum); com 'repair', regrava o montado e libera as escritas.
+int fs_check_writable();
+int superblock_check(int repair);
+
+// Locks por inode. INODE_GUARD trava o inode até o fim do escopo atual.
+// Ao travar mais de um inode, trave sempre o diretório pai antes do filho.
+void inode_lock(uint32_t inode_num);
+void inode_unlock(uint32_t inode_num);
+void inode_guard_release(uint32_t* inode_num);
+uint32_t inode_guard_acquire(uint32_t inode_num);
+
+#define INODE_GUARD_NAME2(line) __inode_guard_##line
+#define INODE_GUARD_NAME(line) INODE_GUARD_NAME2(line)
+#define INODE_GUARD(n) \
+    uint32_t INODE_GUARD_NAME(__LINE__) __attribute__((cleanup(inode_guard_release))) = \
+        inode_guard_acquire(n)
+
+// Como INODE_GUARD, para um inode que o chamador já travou
+#define INODE_GUARD_HELD(n) \
+    uint32_t INODE_GUARD_NAME(__LINE__) __attribute__((cleanup(inode_guard_release))) = (n)
+
+// Bloco de dados que guarda o bloco 'index' do inode, ou 0 se não houver.
+// Com 'alloc', aloca o bloco (e o bloco indireto) que faltar; um bloco novo
+// não é zerado. O chamador deve manter o lock do inode e, depois de alocar,
+// registrar a alteração com mark_inode_dirty.
+uint32_t bmap(uint32_t inode_num, uint32_t index, int alloc);
+
+// Faz o bloco 'index' do inode apontar para 'block' (alocando o bloco
+// indireto, se preciso). Retorna -1 sem espaço. Mesmas regras de bmap.
+int bmap_set(uint32_t inode_num, uint32_t index, uint32_t block);
+
+// Libera todos os blocos de dados do inode e zera seu tamanho. Blocos
+// contíguos são liberados em sequências, com free_data_blocks.
+void inode_truncate(uint32_t inode_num);
+
+// Blocos ocupados pelo inode, incluindo o bloco indireto
+uint32_t inode_blocks(uint32_t inode_num);
+
+// Verifica se a entrada no deslocamento 'offset' de um bloco de diretório é
+// bem formada (rec_len alinhado, dentro do bloco e comportando o nome)
+int dirent_valid(const DirectoryEntry* entry, uint32_t offset);
+
+// Operações de diretório; o chamador deve manter o lock do diretório.
+// dir_foreach chama 'visit' para cada entrada em uso e para na primeira que
+// retornar um valor positivo, que é devolvido; retorna -1 se um bloco do
+// diretório estiver corrompido e 0 ao fim do diretório.
+typedef int (*dir_visit_fn)(const DirectoryEntry* entry, void* arg);
+
+int dir_lookup(uint32_t dir_inode_num, const char* name);
+int dir_add_entry(uint32_t dir_inode_num, const char* name, uint32_t inode_num, uint8_t type);
+int dir_remove_entry(uint32_t dir_inode_num, const char* name);
+int dir_init_block(uint32_t dir_inode_num, uint32_t parent_inode_num);
+int dir_foreach(uint32_t dir_inode_num, dir_visit_fn visit, void* arg);
 
 #endif
@@ -0,0 +1,98 @@
+#ifndef KMEM_H
+#define KMEM_H
+
+#include <stdint.h>
+
+#define PAGE_SIZE 4096
+
+// Tamanho padrão da região de heap logo após a pilha (ver linker.ld)
+#define KMEM_DEFAULT_SIZE (16 * 1024 * 1024)
+
+// Maior heap montado acima do disco em RAM, quando o firmware informa
+// memória para isso (ver kernel.c); o mapa de páginas ocupa 64 KB
+#define KMEM_MAX_SIZE (128 * 1024 * 1024)
+
+/**
+ * @brief Inicializa o alocador de páginas sobre a região [start, end).
+ * * O mapa de páginas é guardado no início da própria região; as caches
+ * de tamanho fixo usadas por kmalloc são criadas aqui.
+ * @param start Endereço inicial da região (alinhado internamente a PAGE_SIZE).
+ * @param end Endereço final (exclusivo) da região.
+ */
+void kmem_init(uintptr_t start, uintptr_t end);
+
+/**
+ * @brief Aloca páginas contíguas.
+ * @param count O número de páginas.
+ * @return Ponteiro alinhado a PAGE_SIZE, ou NULL se não houver espaço contíguo.
+ */
+void* kmem_alloc_pages(uint32_t count);
+
+/**
+ * @brief Libera uma sequência de páginas retornada por kmem_alloc_pages.
+ * @param p O ponteiro retornado na alocação.
+ */
+void kmem_free_pages(void* p);
+
+// Cache de objetos de tamanho fixo (slab de uma página)
+typedef struct KmemCache KmemCache;
+
+/**
+ * @brief Cria uma cache para objetos de tamanho fixo.
+ * @param name Nome exibido pelo comando 'mem'.
+ * @param obj_size Tamanho de cada objeto (arredondado para múltiplo de 8).
+ * @return A cache, ou NULL se o limite de caches foi atingido.
+ */
+KmemCache* kmem_cache_create(const char* name, uint32_t obj_size);
+
+/**
+ * @brief Aloca um objeto de uma cache.
+ * @return Ponteiro para o objeto, ou NULL se não houver memória.
+ */
+void* kmem_cache_alloc(KmemCache* cache);
+
+/**
+ * @brief Devolve um objeto à sua cache.
+ */
+void kmem_cache_free(KmemCache* cache, void* obj);
+
+/**
+ * @brief Aloca memória de uso geral.
+ * * Tamanhos até 2048 bytes vêm das caches por classe de tamanho
+ * (potências de 2); acima disso, de páginas inteiras.
+ * @param size O número de bytes.
+ * @return Ponteiro alinhado a 8 bytes, ou NULL.
+ */
+void* kmalloc(uint32_t size);
+
+/**
+ * @brief Libera memória obtida com kmalloc.
+ */
+void kfree(void* p);
+
+// Arena de rascunho: alocação sequencial, liberada de uma só vez
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+    ArenaChunk* chunks;
+} Arena;
+
+#define ARENA_INIT { NULL }
+
+/**
+ * @brief Aloca 'size' bytes zerados na arena, obtendo páginas conforme necessário.
+ * @return Ponteiro alinhado a 8 bytes, ou NULL se não houver memória.
+ */
+void* arena_alloc(Arena* arena, uint32_t size);
+
+/**
+ * @brief Libera todas as alocações da arena de uma vez.
+ */
+void arena_release(Arena* arena);
+
+/**
+ * @brief Mostra o uso de páginas, a fragmentação e o estado de cada cache.
+ */
+void kmem_stat();
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <stdint.h>
+
+/*
+ * Interface de propriedades do firmware da VideoCore (canal 8 da mailbox 0).
+ * Cada chamada monta um buffer com uma etiqueta, entrega o endereço dele à
+ * VPU e espera a resposta no mesmo buffer. Sem resposta em MBOX_TIMEOUT_US
+ * (um emulador sem a mailbox, por exemplo), a chamada falha.
+ */
+#define MBOX_TIMEOUT_US 100000
+
+// Relógios da interface de propriedades
+#define MBOX_CLOCK_UART 2      // PL011 (UART0)
+#define MBOX_CLOCK_ARM  3
+#define MBOX_CLOCK_CORE 4      // VPU, que também move a Mini UART
+
+/**
+ * @brief Consulta a parte da memória entregue ao ARM (o resto é da GPU).
+ * @param base Recebe o endereço inicial.
+ * @param size Recebe o tamanho em bytes.
+ * @return 0 em caso de sucesso, -1 se o firmware não responder.
+ */
+int mbox_arm_memory(uint32_t* base, uint32_t* size);
+
+/**
+ * @brief Frequência atual de um relógio.
+ * @param clock MBOX_CLOCK_ARM, MBOX_CLOCK_CORE ou MBOX_CLOCK_UART.
+ * @return A frequência em Hz, ou 0 se o firmware não responder.
+ */
+uint32_t mbox_clock_rate(uint32_t clock);
+
+/**
+ * @brief Maior frequência permitida para um relógio (arm_freq, core_freq...
+ * do config.txt).
+ * @param clock Como em mbox_clock_rate.
+ * @return A frequência em Hz, ou 0 se o firmware não responder.
+ */
+uint32_t mbox_max_clock_rate(uint32_t clock);
+
+/**
+ * @brief Pede uma nova frequência para um relógio.
+ * * O firmware arredonda (ou limita) o pedido; releia os relógios que
+ * dependem dele, como o da VPU para a Mini UART.
+ * @param clock Como em mbox_clock_rate.
+ * @param hz A frequência desejada.
+ * @return A frequência obtida em Hz, ou 0 se o firmware não responder.
+ */
+uint32_t mbox_set_clock_rate(uint32_t clock, uint32_t hz);
+
+/**
+ * @brief Mostra a memória do ARM e os relógios do ARM e da VPU.
+ */
+void mbox_stat();
+
+#endif
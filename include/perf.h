@@ -0,0 +1,93 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+
+// Operações instrumentadas (pontos de entrada da API e E/S de blocos). Os
+// números vão para os rastros do blktrace: operações novas entram no fim.
+enum perf_op {
+    PERF_FS_FORMAT,
+    PERF_FS_MOUNT,
+    PERF_FS_STAT,
+    PERF_FS_FSCK,
+    PERF_FIND_ENTRY,
+    PERF_FS_LS,
+    PERF_FS_MKDIR,
+    PERF_FS_TOUCH,
+    PERF_FS_CD,
+    PERF_FS_CAT,
+    PERF_FS_WRITE,
+    PERF_FS_RM,
+    PERF_READ_BLOCK,
+    PERF_WRITE_BLOCK,
+    PERF_READAHEAD,     // Sem uso; mantida para não renumerar os rastros
+    PERF_BLOCK_CSUM,
+    PERF_FS_WALK,
+    PERF_FS_READ,
+    PERF_OP_COUNT
+};
+
+#if defined(CONFIG_PERF) || defined(CONFIG_BLKTRACE)
+#define CONFIG_OP_SCOPES
+#endif
+
+#ifdef CONFIG_OP_SCOPES
+
+typedef struct {
+    uint32_t op;
+    uint32_t start;    // Ciclos na entrada (CONFIG_PERF)
+    uint32_t prev_op;  // Operação corrente anterior (CONFIG_BLKTRACE)
+} PerfScope;
+
+/**
+ * @brief Retorna o nome de uma operação instrumentada.
+ * @param op A operação (enum perf_op).
+ * @return O nome da função correspondente.
+ */
+const char* perf_op_name(uint32_t op);
+
+PerfScope perf_scope_begin(uint32_t op);
+void perf_scope_end(PerfScope* scope);
+
+/**
+ * @brief Instrumenta o escopo atual (até o fim do bloco ou um return).
+ * * Usa o atributo cleanup do GCC, de modo que todos os caminhos de
+ * saída da função são medidos sem precisar instrumentar cada return.
+ * Com CONFIG_PERF mede a duração; com CONFIG_BLKTRACE marca a operação
+ * como a chamadora dos acessos a blocos feitos dentro do escopo.
+ */
+#define PERF_SCOPE(op) \
+    PerfScope __perf_scope __attribute__((cleanup(perf_scope_end))) = perf_scope_begin(op)
+
+#else
+
+#define PERF_SCOPE(op) ((void)0)
+
+#endif
+
+#ifdef CONFIG_PERF
+
+/**
+ * @brief Habilita o contador de ciclos e zera a tabela de latências.
+ */
+void perf_init();
+
+/**
+ * @brief Acumula uma amostra de latência para uma operação.
+ * @param op A operação medida (enum perf_op).
+ * @param cycles A duração da operação, em ciclos de CPU.
+ */
+void perf_record(uint32_t op, uint32_t cycles);
+
+/**
+ * @brief Imprime a tabela de latências pela UART e a zera em seguida.
+ */
+void perf_report();
+
+#else
+
+#define perf_init() ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef POWER_H
+#define POWER_H
+
+/**
+ * @brief Reinicia a placa pelo watchdog do bloco PM (reinicialização a quente).
+ * * O reset não apaga a RAM: o firmware recarrega o kernel, startup.s zera
+ * apenas o .bss e o disco em .noinit é montado de novo, sem formatação,
+ * se o superbloco (magic number e checksum) estiver íntegro.
+ */
+void power_reboot();
+
+#endif
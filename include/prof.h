@@ -0,0 +1,71 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+
+#ifdef CONFIG_PROF
+
+/*
+ * Profiler por amostragem: o timer físico genérico (CNTP) interrompe o
+ * núcleo 'hz' vezes por segundo e a IRQ (vectors.s/vectors64.s) grava o PC
+ * interrompido e o registrador de retorno (lr/x30) em um buffer circular.
+ * O lr só identifica o chamador quando a função interrompida não é folha e
+ * ainda não o sobrescreveu; tools/profsym.py trata-o como uma pista.
+ */
+
+// Capacidade do buffer circular (potência de 2); ao encher, as amostras
+// mais antigas são sobrescritas e contadas como perdidas
+#define PROF_ENTRIES 8192
+
+#define PROF_DEFAULT_HZ 1000
+#define PROF_MAX_HZ     20000
+
+// Cabeçalho do dump binário: "PROF", versão 1
+#define PROF_MAGIC   0x464F5250
+#define PROF_VERSION 1
+
+/**
+ * @brief Instala a tabela de exceções (VBAR) e roteia a interrupção do
+ * timer físico para a IRQ do núcleo 0. As IRQs seguem mascaradas.
+ */
+void prof_init();
+
+/**
+ * @brief Começa a amostragem, descartando as amostras anteriores.
+ * @param hz A frequência de amostragem (1 a PROF_MAX_HZ).
+ * @return 0 em caso de sucesso, -1 se 'hz' estiver fora do intervalo.
+ */
+int prof_start(uint32_t hz);
+
+/**
+ * @brief Para a amostragem e mascara as IRQs; as amostras são mantidas.
+ */
+void prof_stop();
+
+/**
+ * @brief Tratador da IRQ, chamado por vectors.s/vectors64.s com as IRQs
+ * mascaradas.
+ * @param pc O endereço da instrução interrompida.
+ * @param lr O registrador de retorno no momento da interrupção.
+ */
+void prof_irq(uintptr_t pc, uintptr_t lr);
+
+/**
+ * @brief Mostra o estado do profiler e o número de amostras.
+ */
+void prof_stat();
+
+/**
+ * @brief Envia as amostras em formato binário pela UART.
+ * * O fluxo é: magic, versão, número de amostras, frequência, amostras
+ * perdidas e largura dos endereços em bits (6 palavras de 32 bits), seguidos
+ * por pares (pc, lr) de 32 bits, da amostra mais antiga à mais recente.
+ * Ver tools/profsym.py.
+ */
+void prof_dump();
+
+#else
+#define prof_init() ((void)0)
+#endif
+
+#endif
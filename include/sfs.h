@@ -6,16 +6,28 @@
 // API do Sistema de Arquivos
 
 void fs_format();
-void fs_mount();
+int  fs_mount();
+int  fs_mount_opts(uint32_t opts);
+void fs_set_capacity(uint32_t blocks);
+uint32_t fs_capacity();
+int  fs_fsck(int repair);
 void fs_stat();
-int find_entry(const char* name, DirectoryEntry* entry);
+int  find_entry(const char* name);
+int  lock_entry(const char* name);
 void fs_ls();
 int  fs_mkdir(const char* dirname);
 int  fs_touch(const char* filename);
 int  fs_cd(const char* path);
 int  fs_cat(const char* filename);
 int  fs_write(const char* filename, const char* text);
+int  fs_read(const char* filename, uint32_t offset, void* buffer, uint32_t len);
 int  fs_rm(const char* filename);
+int  fs_rm_recursive(const char* filename);
+int  fs_du(const char* name);
+int  fs_find(const char* name);
+int  fs_grep(const char* pattern, const char* name, int recursive);
 const char* fs_get_current_path();
+void fs_context_init(FsContext* ctx);
+void fs_set_context(FsContext* ctx);
 
 #endif
@@ -0,0 +1,68 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <stdint.h>
+
+/*
+ * Tarefas cooperativas em um único núcleo. Cada tarefa tem a sua pilha e o
+ * seu contexto do sistema de arquivos (fs_ctx, o diretório atual); a troca
+ * salva só os registradores preservados pela chamada (task_switch, em
+ * context.s/context64.s). Uma tarefa roda até chamar task_yield, o que as
+ * operações longas fazem a cada bloco. A tarefa 0 é o shell, na pilha do boot.
+ */
+#define TASK_MAX 8
+#define TASK_STACK_PAGES 8          // 32 KB por tarefa
+#define TASK_NAME_LEN 40
+
+/**
+ * @brief Cria uma tarefa, que começa a rodar no próximo task_yield.
+ * * Ela herda uma cópia do contexto do sistema de arquivos de quem a criou
+ * e termina quando 'entry' retorna; a pilha é liberada em seguida.
+ * @param name O nome mostrado por task_list (truncado em TASK_NAME_LEN - 1).
+ * @param entry A função da tarefa.
+ * @param arg O argumento repassado a 'entry'.
+ * @return O identificador da tarefa, ou -1 sem posição livre ou sem memória.
+ */
+int task_spawn(const char* name, void (*entry)(void* arg), void* arg);
+
+/**
+ * @brief Passa o processador à próxima tarefa pronta (rodízio).
+ * * Sem outras tarefas, retorna imediatamente.
+ */
+void task_yield();
+
+/**
+ * @brief Informa quantas tarefas existem além do shell.
+ * @return O número de tarefas criadas por task_spawn ainda em execução.
+ */
+uint32_t task_count();
+
+/**
+ * @brief Identificador da tarefa em execução (0 para o shell).
+ */
+uint32_t task_current();
+
+/**
+ * @brief Informa se um diretório é o diretório atual de alguma tarefa.
+ * * Usada por 'rm', que não libera um diretório em uso.
+ * @param inode_num O inode do diretório.
+ * @return 1 se alguma tarefa estiver nele, 0 caso contrário.
+ */
+int task_uses_dir(uint32_t inode_num);
+
+/**
+ * @brief Lista as tarefas: identificador, trocas de contexto, tempo desde a
+ * criação, pico de uso da pilha e nome.
+ */
+void task_list();
+
+/**
+ * @brief Salva os registradores preservados na pilha atual, guarda o
+ * ponteiro de pilha em '*save_sp' e continua na pilha 'next_sp'.
+ * * Implementada em assembly; retorna quando alguém trocar de volta.
+ * @param save_sp Onde guardar o ponteiro de pilha da tarefa que sai.
+ * @param next_sp O ponteiro de pilha salvo da tarefa que entra.
+ */
+void task_switch(uintptr_t* save_sp, uintptr_t next_sp);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+/**
+ * @brief Lê o contador livre do System Timer do BCM2837.
+ * * O contador roda a 1 MHz a partir do boot, portanto cada tick
+ * corresponde a um microssegundo. Apenas os 32 bits inferiores são
+ * lidos, o que dá uma janela de ~71 minutos entre overflows.
+ * @return O valor atual do contador, em microssegundos.
+ */
+uint32_t timer_now_us();
+
+/**
+ * @brief Habilita o contador de ciclos da PMU (PMCCNTR).
+ * * Liga a PMU (PMCR.E), zera o contador de ciclos e habilita sua
+ * contagem em PMCNTENSET. Deve ser chamada uma vez antes de timer_cycles().
+ */
+void timer_cycles_init();
+
+/**
+ * @brief Lê o contador de ciclos da PMU.
+ * * O contador tem 32 bits e dá a volta em poucos segundos; use apenas
+ * a diferença entre duas leituras próximas (aritmética sem sinal).
+ * @return O número de ciclos de CPU desde timer_cycles_init().
+ */
+uint32_t timer_cycles();
+
+#endif
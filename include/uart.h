@@ -5,14 +5,52 @@
 
 #define LINE_WIDTH 44
 
+// Controladores de UART disponíveis nos pinos GPIO 14/15
+#define UART_MINI  0
+#define UART_PL011 1
+
 /**
- * @brief Inicializa a Mini UART na Raspberry Pi 3.
- * * Configura os pinos GPIO 14 e 15 para suas funções alternativas
- * de UART (TX e RX) e ajusta os registradores da Mini UART para
- * permitir a comunicação serial a 115200 baud.
+ * @brief Inicializa a UART do console na Raspberry Pi 3.
+ * * Usa o controlador e o baud escolhidos no build (make UART=pl011
+ * UART_BAUD=921600); por padrão, a Mini UART a 115200 baud. Se o baud
+ * pedido for inalcançável, volta à Mini UART a 115200.
  */
 void uart_init();
 
+/**
+ * @brief Troca o controlador e o baud do console em tempo de execução.
+ * * Espera a transmissão pendente terminar antes de reprogramar os pinos.
+ * @param backend UART_MINI ou UART_PL011.
+ * @param baud A taxa desejada.
+ * @return 0 em caso de sucesso, -1 se o baud for inalcançável (o console
+ * continua como estava).
+ */
+int uart_configure(int backend, uint32_t baud);
+
+/**
+ * @brief Informa o novo relógio da VPU e recalcula o divisor da Mini UART
+ * para manter o baud atual.
+ * * Chame depois de mudar relógios pelo firmware (mailbox.h), que podem
+ * arrastar o da VPU; a transmissão pendente sai antes, no relógio antigo.
+ * @param hz A frequência da VPU em Hz, lida do firmware.
+ * @return 0 em caso de sucesso, -1 se o baud ficar inalcançável (o console
+ * volta a 115200).
+ */
+int uart_set_core_clock(uint32_t hz);
+
+/**
+ * @brief Espera até que todos os bytes enfileirados tenham saído pela linha.
+ */
+void uart_flush();
+
+/**
+ * @brief Descarta (ou volta a enviar) a saída do console.
+ * * Usada para medir operações que imprimem mensagens sem medir a UART.
+ * @param muted 1 para descartar a saída, 0 para enviá-la.
+ * @return O estado anterior.
+ */
+int uart_set_muted(int muted);
+
 /**
  * @brief Envia um único caractere pela UART.
  * @param c O caractere a ser enviado.
@@ -27,12 +65,44 @@ void uart_putc(unsigned char c);
  */
 unsigned char uart_getc();
 
+/**
+ * @brief Informa se há um caractere esperando para ser lido.
+ * @return 1 se uart_getc retornaria sem esperar, 0 caso contrário.
+ */
+int uart_has_input();
+
 /**
  * @brief Envia uma string (terminada em nulo) pela UART.
  * @param s A string a ser enviada.
  */
 void uart_puts(const char *s);
 
+/**
+ * @brief Envia exatamente 'len' bytes pela UART.
+ * * Para textos sem terminador, como os nomes nas entradas de diretório.
+ * @param s Os bytes a serem enviados.
+ * @param len O número de bytes.
+ */
+void uart_write(const char *s, uint32_t len);
+
+/**
+ * @brief Envia 'len' bytes binários pela UART, sem converter '\n'.
+ * @param data Os bytes a serem enviados.
+ * @param len O número de bytes.
+ */
+void uart_write_raw(const void* data, uint32_t len);
+
+/**
+ * @brief Informa o baud efetivo do console (após o arredondamento do divisor).
+ * @return A taxa em bits por segundo.
+ */
+uint32_t uart_baud();
+
+/**
+ * @brief Mostra o controlador, o baud efetivo e a profundidade da FIFO.
+ */
+void uart_stat();
+
 /**
  * @brief Esta função converte um número inteiro em uma string e a alinha à direita,
  * preenchendo com espaços à esquerda até atingir a largura especificada.
@@ -53,4 +123,13 @@ void uart_puts_right_aligned(int num, int width);
  */
 void uart_puts_aligned(const char* text, int num1, int num2, const char* suffix);
 
+/**
+ * @brief Envia um texto seguido de uma razão com duas casas decimais
+ * (ex.: "1.37x"), alinhada à direita na linha.
+ * @param text O texto a ser enviado.
+ * @param num O numerador.
+ * @param den O denominador (0 mostra "1.00x").
+ */
+void uart_puts_ratio(const char* text, uint32_t num, uint32_t den);
+
 #endif
@@ -0,0 +1,48 @@
+#ifndef UART_BACKEND_H
+#define UART_BACKEND_H
+
+#include <stdint.h>
+
+// Endereços de memória (MMIO) para os periféricos da Raspberry Pi 2/3
+#define PERIPHERAL_BASE   0x3F000000
+#define GPIO_BASE         (PERIPHERAL_BASE + 0x200000)
+
+// Funções alternativas dos pinos GPIO 14/15 (TX/RX)
+#define GPIO_ALT0 4   // PL011 (UART0)
+#define GPIO_ALT5 2   // Mini UART (UART1)
+
+/*
+ * Operações de um controlador de UART. uart.c escolhe um deles e monta
+ * sobre estas operações as rotinas de texto e as escritas em rajada: quando
+ * tx_room informa espaço para n bytes, eles são escritos sem novas consultas
+ * ao registrador de estado.
+ */
+typedef struct {
+    const char* name;
+    uint32_t fifo_depth;
+    int (*init)(uint32_t baud);      // 0 em caso de sucesso, -1 se o baud for inalcançável
+    uint32_t (*actual_baud)();       // Taxa obtida após o arredondamento do divisor
+    uint32_t (*tx_room)();           // Bytes que podem ser escritos sem esperar
+    void (*tx)(unsigned char c);
+    int (*rx_ready)();
+    unsigned char (*rx)();
+    int (*tx_idle)();                // FIFO e registrador de deslocamento vazios
+} UartBackend;
+
+extern const UartBackend mini_uart_backend;
+extern const UartBackend pl011_backend;
+
+/**
+ * @brief Informa o relógio da VPU, do qual sai o baud da Mini UART.
+ * * Vale para o próximo init; não reprograma o divisor atual.
+ * @param hz A frequência em Hz.
+ */
+void mini_uart_set_clock(uint32_t hz);
+
+/**
+ * @brief Liga os pinos GPIO 14 e 15 a uma função alternativa, sem pull-up/down.
+ * @param alt GPIO_ALT0 (PL011) ou GPIO_ALT5 (Mini UART).
+ */
+void uart_gpio_setup(uint32_t alt);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef WALK_H
+#define WALK_H
+
+#include <stdint.h>
+
+// Momento da visita: arquivos só são visitados em WALK_PRE; diretórios, em
+// WALK_PRE ao serem encontrados e em WALK_POST depois de todo o seu conteúdo
+#define WALK_PRE  0
+#define WALK_POST 1
+
+// Retorno do callback em WALK_PRE de um diretório: não descer nele
+#define WALK_SKIP 1
+
+typedef struct {
+    uint32_t inode_num;
+    uint32_t parent_inode;
+    uint8_t type;          // Tipo do inode (ATTR_FILE ou ATTR_DIRECTORY)
+    uint32_t depth;        // 1 para as entradas do diretório inicial
+    const char* name;      // Nome da entrada, terminado em nulo (só em WALK_PRE)
+    const char* path;      // Caminho a partir do diretório inicial
+} WalkEntry;
+
+typedef int (*walk_fn)(const WalkEntry* entry, int when, void* arg);
+
+/**
+ * @brief Percorre a subárvore de um diretório em profundidade, sem recursão.
+ * * A pilha de diretórios abertos (bloco e deslocamento em cada um) fica
+ * em uma arena do kmem, não na pilha de 4 KB. Cada diretório é travado
+ * ao entrar e liberado ao sair, na ordem pai -> filho; o diretório
+ * inicial deve estar travado pelo chamador. Um callback em WALK_POST
+ * ainda tem o diretório travado; os arquivos não são travados. Entradas
+ * que apontam para inodes livres ou já visitados são ignoradas, o que
+ * também protege o percurso de ciclos em um disco corrompido. Um caminho
+ * que não caiba em MAX_PATH_LEN bytes é truncado no último componente
+ * que coube.
+ * @param dir_inode O diretório inicial (não é visitado).
+ * @param path O caminho do diretório inicial, prefixo dos demais.
+ * @param visit O callback; um valor negativo interrompe o percurso.
+ * @param arg Argumento repassado ao callback.
+ * @return 0 ao fim do percurso, o valor negativo devolvido pelo callback,
+ * -1 se um bloco de diretório estiver corrompido ou -2 sem memória.
+ */
+int fs_walk(uint32_t dir_inode, const char* path, walk_fn visit, void* arg);
+
+#endif
@@ -22,9 +22,27 @@ char* strcpy(char *dest, const char *src) {
     return orig_dest;
 }
 
+// Palavra nativa: 4 bytes no armv7-a, 8 no AArch64
+typedef unsigned long __attribute__((may_alias)) word_t;
+#define WORD_MASK (sizeof(word_t) - 1)
+
 void* memcpy(void *dest, const void *src, uint32_t n) {
     char *d = dest;
     const char *s = src;
+
+    // Com o mesmo alinhamento, copia uma palavra nativa por vez
+    if ((((uintptr_t)d ^ (uintptr_t)s) & WORD_MASK) == 0) {
+        while (n > 0 && ((uintptr_t)d & WORD_MASK)) {
+            *d++ = *s++;
+            n--;
+        }
+        while (n >= sizeof(word_t)) {
+            *(word_t*)d = *(const word_t*)s;
+            d += sizeof(word_t);
+            s += sizeof(word_t);
+            n -= sizeof(word_t);
+        }
+    }
     while (n--) {
         *d++ = *s++;
     }
@@ -33,12 +51,60 @@ void* memcpy(void *dest, const void *src, uint32_t n) {
 
 void* memset(void *s, int c, uint32_t n) {
     unsigned char *p = s;
+    word_t pattern = ((word_t)-1 / 0xFF) * (unsigned char)c;  // O byte repetido
+
+    while (n > 0 && ((uintptr_t)p & WORD_MASK)) {
+        *p++ = (unsigned char)c;
+        n--;
+    }
+    while (n >= sizeof(word_t)) {
+        *(word_t*)p = pattern;
+        p += sizeof(word_t);
+        n -= sizeof(word_t);
+    }
     while (n--) {
         *p++ = (unsigned char)c;
     }
     return s;
 }
 
+// Procura um byte uma palavra por vez: com x = palavra ^ padrão, a expressão
+// (x - 0x01..01) & ~x & 0x80..80 só é zero se nenhum byte de x for zero. Um
+// acerto pode vir de um byte depois do primeiro zero, então a palavra que
+// acusar é conferida byte a byte.
+void* memchr(const void *s, int c, uint32_t n) {
+    const unsigned char *p = s;
+    unsigned char ch = (unsigned char)c;
+    word_t ones = (word_t)-1 / 0xFF;
+    word_t highs = ones << 7;
+    word_t pattern = ones * ch;
+
+    while (n > 0 && ((uintptr_t)p & WORD_MASK)) {
+        if (*p == ch) return (void*)p;
+        p++;
+        n--;
+    }
+    while (n >= sizeof(word_t)) {
+        word_t x = *(const word_t*)p ^ pattern;
+        if ((x - ones) & ~x & highs) break;
+        p += sizeof(word_t);
+        n -= sizeof(word_t);
+    }
+    while (n--) {
+        if (*p == ch) return (void*)p;
+        p++;
+    }
+    return NULL;
+}
+
+int memcmp(const void *s1, const void *s2, uint32_t n) {
+    const unsigned char *a = s1, *b = s2;
+    for (uint32_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) return a[i] - b[i];
+    }
+    return 0;
+}
+
 char* strcat(char *dest, const char *src) {
     char *p = dest + strlen(dest);
     strcpy(p, src);
@@ -82,3 +148,29 @@ void itoa(int n, char* buffer) {
         end--;
     }
 }
+
+int parse_uint(const char* s, uint32_t* value) {
+    uint32_t n = 0;
+    if (*s == '\0') return -1;
+    for (; *s; s++) {
+        if (*s < '0' || *s > '9') return -1;
+        uint32_t digit = *s - '0';
+        if (n > (0xFFFFFFFFu - digit) / 10) return -1;
+        n = n * 10 + digit;
+    }
+    *value = n;
+    return 0;
+}
+
+uint32_t udiv32(uint32_t n, uint32_t d) {
+    uint32_t q = 0;
+    uint64_t r = 0;  // 64 bits: o deslocamento pode passar de 32 bits se d > 2^31
+    for (int i = 31; i >= 0; i--) {
+        r = (r << 1) | ((n >> i) & 1);
+        if (r >= d) {
+            r -= d;
+            q |= 1u << i;
+        }
+    }
+    return q;
+}
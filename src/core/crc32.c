@@ -0,0 +1,76 @@
+#include "crc32.h"
+
+#ifdef __ARM_FEATURE_CRC32
+
+#include <arm_acle.h>
+
+uint32_t crc32(uint32_t crc, const void* data, uint32_t len) {
+    const uint8_t* p = data;
+    crc = ~crc;
+
+    // Alinha o ponteiro e processa uma palavra por instrução
+    while (len > 0 && ((uintptr_t)p & 3)) {
+        crc = __crc32b(crc, *p++);
+        len--;
+    }
+    while (len >= 4) {
+        crc = __crc32w(crc, *(const uint32_t*)p);
+        p += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        crc = __crc32b(crc, *p++);
+        len--;
+    }
+    return ~crc;
+}
+
+#else
+
+// Tabelas "slice-by-4": crc_table[k][b] é o CRC do byte b seguido de k zeros
+static uint32_t crc_table[4][256];
+static int crc_table_ready = 0;
+
+// Gera as tabelas na primeira chamada (4 KB em .bss em vez de .rodata)
+static void build_table() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+        }
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 4; k++) {
+            uint32_t prev = crc_table[k - 1][i];
+            crc_table[k][i] = (prev >> 8) ^ crc_table[0][prev & 0xFF];
+        }
+    }
+    crc_table_ready = 1;
+}
+
+uint32_t crc32(uint32_t crc, const void* data, uint32_t len) {
+    const uint8_t* p = data;
+    if (!crc_table_ready) build_table();
+
+    crc = ~crc;
+    while (len > 0 && ((uintptr_t)p & 3)) {
+        crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+    // Quatro bytes por iteração, com uma consulta independente por byte
+    while (len >= 4) {
+        crc ^= *(const uint32_t*)p;
+        crc = crc_table[3][crc & 0xFF] ^ crc_table[2][(crc >> 8) & 0xFF]
+            ^ crc_table[1][(crc >> 16) & 0xFF] ^ crc_table[0][crc >> 24];
+        p += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+    return ~crc;
+}
+
+#endif
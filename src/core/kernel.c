@@ -1,14 +1,87 @@
 #include "uart.h"
 #include "shell.h"
 #include "sfs.h"
+#include "perf.h"
+#include "kmem.h"
+#include "timer.h"
+#include "prof.h"
+#include "mailbox.h"
 
-void main() {
+// Definidos em linker.ld
+extern char __heap_start[];
+extern char __noinit_start[];
+extern char __disk_start[];
+
+// Mostra a duração de uma fase do boot
+static void boot_phase(const char* name, uint32_t from, uint32_t to) {
+    uart_puts_aligned(name, to - from, -1, " us");
+}
+
+// 'entry_us' é o System Timer lido por startup.s antes de zerar o .bss
+void main(uint32_t entry_us) {
+    uint32_t t_main = timer_now_us();
     uart_init();
+    perf_init();
+    prof_init();
+    uint32_t t_init = timer_now_us();
+
+    // ARM no relógio máximo do config.txt (arm_freq). A troca pode arrastar
+    // o relógio da VPU, que move a Mini UART: o divisor é refeito com o
+    // valor lido de volta.
+    uart_flush();
+    uint32_t arm_max = mbox_max_clock_rate(MBOX_CLOCK_ARM);
+    if (arm_max) mbox_set_clock_rate(MBOX_CLOCK_ARM, arm_max);
+    uart_set_core_clock(mbox_clock_rate(MBOX_CLOCK_CORE));
+
+    // Sem resposta do firmware, o heap termina antes de .noinit e o disco
+    // tem o tamanho padrão. Com a memória do ARM conhecida, o heap vai para o
+    // topo dela e o disco, último item de .noinit, ocupa os blocos inteiros
+    // entre __disk_start e o heap.
+    uintptr_t heap_start = (uintptr_t)__heap_start;
+    uintptr_t heap_end = heap_start + KMEM_DEFAULT_SIZE;
+    if (heap_end > (uintptr_t)__noinit_start) heap_end = (uintptr_t)__noinit_start;
+    uint32_t mem_base, mem_size;
+    if (mbox_arm_memory(&mem_base, &mem_size) == 0) {
+        uintptr_t arm_end = ((uintptr_t)mem_base + mem_size) & ~(uintptr_t)(PAGE_SIZE - 1);
+        uintptr_t disk = (uintptr_t)__disk_start;
+        uintptr_t room = arm_end > disk ? arm_end - disk : 0;
+        uintptr_t min_disk = DISK_DEFAULT_BLOCKS * BLOCK_SIZE;
+        uintptr_t heap_size = room >= min_disk + KMEM_MAX_SIZE ? KMEM_MAX_SIZE : KMEM_DEFAULT_SIZE;
+        if (room >= min_disk + heap_size) {
+            heap_end = arm_end;
+            heap_start = arm_end - heap_size;
+            fs_set_capacity((heap_start - disk) / BLOCK_SIZE);
+        }
+    }
+    uint32_t t_mbox = timer_now_us();
+    kmem_init(heap_start, heap_end);
+    uint32_t t_heap = timer_now_us();
+
     uart_puts("\n===== SimpleFS Bare-Metal no Raspberry Pi 3 =====\n");
 
-    fs_format();
-    fs_mount();
-    uart_puts("Sistema de arquivos formatado e montado.\n");
+    // Após uma reinicialização a quente, o disco ainda tem um sistema de
+    // arquivos válido e é só montado; na primeira vez, é formatado
+    int formatted = fs_mount_opts(MOUNT_BOOT_OPTS);
+    uint32_t t_mount = timer_now_us();
+    if (formatted) {
+        uart_puts("Sistema de arquivos formatado e montado.\n");
+    } else {
+        uart_puts("Sistema de arquivos existente montado.\n");
+    }
+    uart_puts_aligned(" Disco / capacidade", sb.total_blocks / (1024 * 1024 / BLOCK_SIZE),
+                      fs_capacity() / (1024 * 1024 / BLOCK_SIZE), " MB");
+    uart_puts_aligned(" Heap (kmem)", (heap_end - heap_start) >> 20, -1, " MB");
+    mbox_stat();
+
+    uart_puts("--- Tempo de boot ---\n");
+    boot_phase(" Firmware (ate _start)", 0, entry_us);
+    boot_phase(" Zerar .bss", entry_us, t_main);
+    boot_phase(" UART e perf", t_main, t_init);
+    boot_phase(" Firmware (mailbox)", t_init, t_mbox);
+    boot_phase(" Heap (kmem)", t_mbox, t_heap);
+    boot_phase(formatted ? " Formatacao e montagem" : " Montagem", t_heap, t_mount);
+    boot_phase(" Total desde _start", entry_us, t_mount);
+    uart_puts("-------------------------------------------\n");
     uart_puts("Digite 'help' para ver os comandos.\n");
 
     shell_start();
@@ -0,0 +1,293 @@
+#include "kmem.h"
+#include "common.h"
+#include "uart.h"
+#include "atomic.h"
+
+// Estados no mapa de páginas (um uint16_t por página):
+//   0            página livre
+//   PAGE_CONT    continuação de uma sequência alocada
+//   n | flags    primeira página de uma sequência de n páginas
+#define PAGE_CONT    0xFFFF
+#define PAGE_SLAB    0x8000
+#define PAGE_RUN_MAX 0x7FFF
+
+#define MAX_CACHES   16
+#define SLAB_MIN_CLASS 16
+#define SLAB_MAX_CLASS 2048
+
+// Cabeçalho no início de cada página de slab
+typedef struct Slab {
+    KmemCache* cache;
+    struct Slab* next;
+    void* free_list;
+    uint32_t in_use;
+    uint32_t capacity;
+} Slab;
+
+struct KmemCache {
+    const char* name;
+    uint32_t obj_size;
+    Slab* slabs;
+    uint32_t slab_count;
+    uint32_t in_use;
+};
+
+struct ArenaChunk {
+    ArenaChunk* next;
+    uint32_t used;
+    uint32_t size;
+};
+
+static uintptr_t heap_base;
+static uint32_t heap_pages;
+static uint16_t* page_map;
+static uint32_t pages_used;
+
+static KmemCache caches[MAX_CACHES];
+static uint32_t cache_count;
+static KmemCache* size_classes[8];   // 16, 32, ..., 2048 bytes
+static const char* size_class_names[8] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048"
+};
+
+static uint32_t arena_pages_peak;
+static uint32_t arena_pages_live;
+
+static Spinlock kmem_lock;
+
+// ALOCADOR DE PÁGINAS
+
+void kmem_init(uintptr_t start, uintptr_t end) {
+    heap_base = (start + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1);
+    heap_pages = (end - heap_base) / PAGE_SIZE;
+
+    // O mapa ocupa as primeiras páginas da própria região
+    uint32_t map_pages = (heap_pages * sizeof(uint16_t) + PAGE_SIZE - 1) / PAGE_SIZE;
+    page_map = (uint16_t*)heap_base;
+    memset(page_map, 0, heap_pages * sizeof(uint16_t));
+    page_map[0] = map_pages;
+    for (uint32_t i = 1; i < map_pages; i++) page_map[i] = PAGE_CONT;
+    pages_used = map_pages;
+
+    cache_count = 0;
+    for (uint32_t i = 0; i < 8; i++) {
+        size_classes[i] = kmem_cache_create(size_class_names[i], SLAB_MIN_CLASS << i);
+    }
+}
+
+static void* alloc_pages_locked(uint32_t count, uint16_t flags) {
+    if (count == 0 || count > PAGE_RUN_MAX) return NULL;
+
+    // Primeira sequência livre que caiba (first-fit)
+    uint32_t run = 0;
+    for (uint32_t i = 0; i < heap_pages; i++) {
+        if (page_map[i] != 0) {
+            run = 0;
+            continue;
+        }
+        if (++run == count) {
+            uint32_t first = i + 1 - count;
+            page_map[first] = count | flags;
+            for (uint32_t j = first + 1; j <= i; j++) page_map[j] = PAGE_CONT;
+            pages_used += count;
+            return (void*)(heap_base + (uintptr_t)first * PAGE_SIZE);
+        }
+    }
+    return NULL;
+}
+
+static void free_pages_locked(void* p) {
+    uint32_t first = ((uintptr_t)p - heap_base) / PAGE_SIZE;
+    uint32_t count = page_map[first] & PAGE_RUN_MAX;
+    for (uint32_t i = 0; i < count; i++) page_map[first + i] = 0;
+    pages_used -= count;
+}
+
+void* kmem_alloc_pages(uint32_t count) {
+    spin_lock(&kmem_lock);
+    void* p = alloc_pages_locked(count, 0);
+    spin_unlock(&kmem_lock);
+    return p;
+}
+
+void kmem_free_pages(void* p) {
+    if (!p) return;
+    spin_lock(&kmem_lock);
+    free_pages_locked(p);
+    spin_unlock(&kmem_lock);
+}
+
+// CACHES DE OBJETOS (SLAB)
+
+KmemCache* kmem_cache_create(const char* name, uint32_t obj_size) {
+    if (cache_count >= MAX_CACHES) return NULL;
+    KmemCache* c = &caches[cache_count++];
+    c->name = name;
+    c->obj_size = (obj_size + 7) & ~7u;
+    if (c->obj_size < sizeof(void*)) c->obj_size = sizeof(void*);
+    c->slabs = NULL;
+    c->slab_count = 0;
+    c->in_use = 0;
+    return c;
+}
+
+// Cria um slab de uma página e encadeia seus objetos na lista livre
+static Slab* new_slab(KmemCache* c) {
+    Slab* s = alloc_pages_locked(1, PAGE_SLAB);
+    if (!s) return NULL;
+
+    s->cache = c;
+    s->free_list = NULL;
+    s->in_use = 0;
+    s->capacity = 0;
+    uintptr_t first = ((uintptr_t)s + sizeof(Slab) + 7) & ~(uintptr_t)7;
+    for (uintptr_t obj = first; obj + c->obj_size <= (uintptr_t)s + PAGE_SIZE; obj += c->obj_size) {
+        *(void**)obj = s->free_list;
+        s->free_list = (void*)obj;
+        s->capacity++;
+    }
+
+    s->next = c->slabs;
+    c->slabs = s;
+    c->slab_count++;
+    return s;
+}
+
+void* kmem_cache_alloc(KmemCache* c) {
+    spin_lock(&kmem_lock);
+    Slab* s = c->slabs;
+    while (s && !s->free_list) s = s->next;
+    if (!s) s = new_slab(c);
+
+    void* obj = NULL;
+    if (s) {
+        obj = s->free_list;
+        s->free_list = *(void**)obj;
+        s->in_use++;
+        c->in_use++;
+    }
+    spin_unlock(&kmem_lock);
+    return obj;
+}
+
+void kmem_cache_free(KmemCache* c, void* obj) {
+    if (!obj) return;
+    spin_lock(&kmem_lock);
+    Slab* s = (Slab*)((uintptr_t)obj & ~(uintptr_t)(PAGE_SIZE - 1));
+    *(void**)obj = s->free_list;
+    s->free_list = obj;
+    s->in_use--;
+    c->in_use--;
+
+    // Devolve slabs vazios ao alocador de páginas, mantendo ao menos um
+    if (s->in_use == 0 && c->slab_count > 1) {
+        Slab** link = &c->slabs;
+        while (*link != s) link = &(*link)->next;
+        *link = s->next;
+        c->slab_count--;
+        free_pages_locked(s);
+    }
+    spin_unlock(&kmem_lock);
+}
+
+void* kmalloc(uint32_t size) {
+    if (size > SLAB_MAX_CLASS) {
+        return kmem_alloc_pages((size + PAGE_SIZE - 1) / PAGE_SIZE);
+    }
+    uint32_t cls = 0;
+    while ((uint32_t)(SLAB_MIN_CLASS << cls) < size) cls++;
+    return kmem_cache_alloc(size_classes[cls]);
+}
+
+void kfree(void* p) {
+    if (!p) return;
+    uint32_t page = ((uintptr_t)p - heap_base) / PAGE_SIZE;
+    if (page_map[page] != PAGE_CONT && (page_map[page] & PAGE_SLAB)) {
+        Slab* s = (Slab*)((uintptr_t)p & ~(uintptr_t)(PAGE_SIZE - 1));
+        kmem_cache_free(s->cache, p);
+    } else {
+        kmem_free_pages(p);
+    }
+}
+
+// ARENAS DE RASCUNHO
+
+void* arena_alloc(Arena* arena, uint32_t size) {
+    size = (size + 7) & ~7u;
+    ArenaChunk* c = arena->chunks;
+
+    if (!c || c->used + size > c->size) {
+        uint32_t header = (sizeof(ArenaChunk) + 7) & ~7u;
+        uint32_t pages = (size + header + PAGE_SIZE - 1) / PAGE_SIZE;
+        c = kmem_alloc_pages(pages);
+        if (!c) return NULL;
+        c->next = arena->chunks;
+        c->used = header;
+        c->size = pages * PAGE_SIZE;
+        arena->chunks = c;
+
+        spin_lock(&kmem_lock);
+        arena_pages_live += pages;
+        if (arena_pages_live > arena_pages_peak) arena_pages_peak = arena_pages_live;
+        spin_unlock(&kmem_lock);
+    }
+
+    void* p = (char*)c + c->used;
+    c->used += size;
+    memset(p, 0, size);
+    return p;
+}
+
+void arena_release(Arena* arena) {
+    while (arena->chunks) {
+        ArenaChunk* c = arena->chunks;
+        arena->chunks = c->next;
+
+        spin_lock(&kmem_lock);
+        arena_pages_live -= c->size / PAGE_SIZE;
+        free_pages_locked(c);
+        spin_unlock(&kmem_lock);
+    }
+}
+
+// ESTATÍSTICAS
+
+void kmem_stat() {
+    spin_lock(&kmem_lock);
+
+    // Fragmentação externa: quanto da memória livre está fora da maior sequência
+    uint32_t largest = 0, run = 0, free_runs = 0;
+    for (uint32_t i = 0; i < heap_pages; i++) {
+        if (page_map[i] == 0) {
+            if (run++ == 0) free_runs++;
+            if (run > largest) largest = run;
+        } else {
+            run = 0;
+        }
+    }
+    uint32_t free_pages = heap_pages - pages_used;
+    uint32_t frag = free_pages ? 100 - udiv32(largest * 100, free_pages) : 0;
+
+    uart_puts("--- Memoria do kernel ---\n");
+    uart_puts_aligned(" Paginas usadas", pages_used, heap_pages, NULL);
+    uart_puts_aligned(" Sequencias livres", free_runs, -1, NULL);
+    uart_puts_aligned(" Maior sequencia livre", largest, -1, " pag");
+    uart_puts_aligned(" Fragmentacao externa", frag, -1, " %");
+    uart_puts_aligned(" Paginas de arenas", arena_pages_live, -1, NULL);
+    uart_puts_aligned(" Pico das arenas", arena_pages_peak, -1, " pag");
+    uart_puts(" Caches (objetos em uso / capacidade):\n");
+    for (uint32_t i = 0; i < cache_count; i++) {
+        KmemCache* c = &caches[i];
+        if (c->slab_count == 0) continue;
+
+        uint32_t capacity = 0;
+        for (Slab* s = c->slabs; s; s = s->next) capacity += s->capacity;
+        char label[24] = "  ";
+        strcat(label, c->name);
+        uart_puts_aligned(label, c->in_use, capacity, NULL);
+    }
+    uart_puts("-------------------------------------------\n");
+
+    spin_unlock(&kmem_lock);
+}
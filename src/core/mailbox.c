@@ -0,0 +1,108 @@
+#include "mailbox.h"
+#include "uart_backend.h"
+#include "common.h"
+#include "uart.h"
+#include "timer.h"
+
+// Mailbox 0: o ARM lê as respostas da VPU; a mailbox 1 recebe os pedidos
+#define MBOX_BASE    (PERIPHERAL_BASE + 0xB880)
+#define MBOX_READ    ((volatile uint32_t*)(MBOX_BASE + 0x00))
+#define MBOX_STATUS  ((volatile uint32_t*)(MBOX_BASE + 0x18))
+#define MBOX_WRITE   ((volatile uint32_t*)(MBOX_BASE + 0x20))
+#define MBOX_FULL    0x80000000
+#define MBOX_EMPTY   0x40000000
+
+#define MBOX_CH_PROP 8          // Propriedades, do ARM para a VPU
+
+#define MBOX_REQUEST  0x00000000
+#define MBOX_RESPONSE 0x80000000   // Código do buffer quando a VPU atendeu
+
+// Etiquetas usadas
+#define TAG_GET_ARM_MEMORY     0x00010005
+#define TAG_GET_CLOCK_RATE     0x00030002
+#define TAG_GET_MAX_CLOCK_RATE 0x00030004
+#define TAG_SET_CLOCK_RATE     0x00038002
+#define TAG_END                0
+
+// Buffer de uma etiqueta: tamanho, código, etiqueta, tamanho dos valores,
+// código da etiqueta, até 3 valores e o terminador. Os 4 bits baixos do
+// endereço levam o canal, daí o alinhamento a 16.
+static volatile uint32_t mbox[9] __attribute__((aligned(16)));
+
+static int mbox_wait(uint32_t flag) {
+    uint32_t start = timer_now_us();
+    while (*MBOX_STATUS & flag) {
+        if (timer_now_us() - start > MBOX_TIMEOUT_US) return -1;
+    }
+    return 0;
+}
+
+// Envia uma etiqueta com 'count' valores (entrada e saída, no mesmo lugar)
+static int mbox_call(uint32_t tag, uint32_t* values, uint32_t count) {
+    mbox[0] = sizeof(mbox);
+    mbox[1] = MBOX_REQUEST;
+    mbox[2] = tag;
+    mbox[3] = count * 4;
+    mbox[4] = 0;
+    for (uint32_t i = 0; i < count; i++) mbox[5 + i] = values[i];
+    mbox[5 + count] = TAG_END;
+
+    uint32_t msg = (uint32_t)(uintptr_t)mbox | MBOX_CH_PROP;
+    asm volatile("dsb sy" ::: "memory");
+    if (mbox_wait(MBOX_FULL) != 0) return -1;
+    *MBOX_WRITE = msg;
+
+    // Descarta respostas de outros canais até chegar a nossa
+    while (1) {
+        if (mbox_wait(MBOX_EMPTY) != 0) return -1;
+        if (*MBOX_READ == msg) break;
+    }
+    asm volatile("dsb sy" ::: "memory");
+    if (mbox[1] != MBOX_RESPONSE || !(mbox[4] & MBOX_RESPONSE)) return -1;
+    for (uint32_t i = 0; i < count; i++) values[i] = mbox[5 + i];
+    return 0;
+}
+
+int mbox_arm_memory(uint32_t* base, uint32_t* size) {
+    uint32_t v[2] = { 0, 0 };
+    if (mbox_call(TAG_GET_ARM_MEMORY, v, 2) != 0 || v[1] == 0) return -1;
+    *base = v[0];
+    *size = v[1];
+    return 0;
+}
+
+static uint32_t clock_query(uint32_t tag, uint32_t clock) {
+    uint32_t v[2] = { clock, 0 };
+    if (mbox_call(tag, v, 2) != 0 || v[0] != clock) return 0;
+    return v[1];
+}
+
+uint32_t mbox_clock_rate(uint32_t clock) {
+    return clock_query(TAG_GET_CLOCK_RATE, clock);
+}
+
+uint32_t mbox_max_clock_rate(uint32_t clock) {
+    return clock_query(TAG_GET_MAX_CLOCK_RATE, clock);
+}
+
+uint32_t mbox_set_clock_rate(uint32_t clock, uint32_t hz) {
+    // O terceiro valor (1) pede para não mudar o modo turbo
+    uint32_t v[3] = { clock, hz, 1 };
+    if (mbox_call(TAG_SET_CLOCK_RATE, v, 3) != 0 || v[0] != clock) return 0;
+    return v[1];
+}
+
+void mbox_stat() {
+    uint32_t base, size;
+    if (mbox_arm_memory(&base, &size) != 0) {
+        const char* text = " Firmware (mailbox)";
+        uart_puts(text);
+        for (int i = strlen(text) + strlen("sem resposta"); i < LINE_WIDTH; i++) uart_puts(" ");
+        uart_puts("sem resposta\n");
+        return;
+    }
+    uart_puts_aligned(" Memoria do ARM", size >> 20, -1, " MB");
+    uart_puts_aligned(" Relogio do ARM / maximo", mbox_clock_rate(MBOX_CLOCK_ARM) / 1000000,
+                      mbox_max_clock_rate(MBOX_CLOCK_ARM) / 1000000, " MHz");
+    uart_puts_aligned(" Relogio da VPU", mbox_clock_rate(MBOX_CLOCK_CORE) / 1000000, -1, " MHz");
+}
@@ -0,0 +1,82 @@
+#include "uart_backend.h"
+#include "common.h"
+
+#define AUX_BASE          (PERIPHERAL_BASE + 0x215000)
+
+// Registradores Auxiliares e Mini UART
+#define AUX_ENABLES       ((volatile uint32_t*)(AUX_BASE + 0x04))
+#define AUX_MU_IO_REG     ((volatile uint32_t*)(AUX_BASE + 0x40))
+#define AUX_MU_IER_REG    ((volatile uint32_t*)(AUX_BASE + 0x44))
+#define AUX_MU_IIR_REG    ((volatile uint32_t*)(AUX_BASE + 0x48))
+#define AUX_MU_LCR_REG    ((volatile uint32_t*)(AUX_BASE + 0x4C))
+#define AUX_MU_MCR_REG    ((volatile uint32_t*)(AUX_BASE + 0x50))
+#define AUX_MU_LSR_REG    ((volatile uint32_t*)(AUX_BASE + 0x54))
+#define AUX_MU_CNTL_REG   ((volatile uint32_t*)(AUX_BASE + 0x60))
+#define AUX_MU_STAT_REG   ((volatile uint32_t*)(AUX_BASE + 0x64))
+#define AUX_MU_BAUD_REG   ((volatile uint32_t*)(AUX_BASE + 0x68))
+
+// O relógio da Mini UART é o da VPU: core_freq=250 no config.txt até que
+// o kernel leia o valor real do firmware (mini_uart_set_clock)
+#define MINI_UART_DEFAULT_CLOCK 250000000
+#define MINI_UART_FIFO    8
+
+static uint32_t baud_reg;
+static uint32_t uart_clock = MINI_UART_DEFAULT_CLOCK;
+
+void mini_uart_set_clock(uint32_t hz) {
+    uart_clock = hz;
+}
+
+static int mini_init(uint32_t baud) {
+    // Baudrate = system_clock_freq / (8 * (baud_reg + 1)), arredondado
+    if (baud == 0 || baud > uart_clock / 8) return -1;
+    uint32_t divisor = udiv32(uart_clock + 4 * baud, 8 * baud);
+    if (divisor == 0 || divisor > 0x10000) return -1;
+    baud_reg = divisor - 1;
+
+    uart_gpio_setup(GPIO_ALT5);
+
+    *AUX_ENABLES |= 1;     // Habilita a Mini UART (bit 0)
+    *AUX_MU_CNTL_REG = 0;  // Desabilita transmissor e receptor durante a configuração
+    *AUX_MU_IER_REG = 0;   // Desabilita interrupções
+    *AUX_MU_LCR_REG = 3;   // Define modo de 8 bits
+    *AUX_MU_MCR_REG = 0;   // Define RTS para nível alto
+    *AUX_MU_IIR_REG = 6;   // Limpa as filas (FIFOs)
+    *AUX_MU_BAUD_REG = baud_reg;
+
+    // Habilita o transmissor e o receptor
+    *AUX_MU_CNTL_REG = 3;
+    return 0;
+}
+
+static uint32_t mini_actual_baud() {
+    return udiv32(uart_clock, 8 * (baud_reg + 1));
+}
+
+// Bits 24-27 do registrador de estado: bytes na fila de transmissão
+static uint32_t mini_tx_room() {
+    return MINI_UART_FIFO - ((*AUX_MU_STAT_REG >> 24) & 0xF);
+}
+
+static void mini_tx(unsigned char c) {
+    *AUX_MU_IO_REG = c;
+}
+
+// Há dados para ler (bit 0 do LSR)
+static int mini_rx_ready() {
+    return *AUX_MU_LSR_REG & 0x01;
+}
+
+static unsigned char mini_rx() {
+    return *AUX_MU_IO_REG & 0xFF;
+}
+
+// Transmissor ocioso (bit 6 do LSR)
+static int mini_tx_idle() {
+    return (*AUX_MU_LSR_REG & 0x40) != 0;
+}
+
+const UartBackend mini_uart_backend = {
+    "mini", MINI_UART_FIFO, mini_init, mini_actual_baud,
+    mini_tx_room, mini_tx, mini_rx_ready, mini_rx, mini_tx_idle,
+};
@@ -0,0 +1,112 @@
+#include "perf.h"
+#include "common.h"
+#include "uart.h"
+#include "timer.h"
+#include "blktrace.h"
+
+#ifdef CONFIG_OP_SCOPES
+
+static const char* perf_names[PERF_OP_COUNT] = {
+    [PERF_FS_FORMAT]   = "fs_format",
+    [PERF_FS_MOUNT]    = "fs_mount",
+    [PERF_FS_STAT]     = "fs_stat",
+    [PERF_FS_FSCK]     = "fs_fsck",
+    [PERF_FIND_ENTRY]  = "find_entry",
+    [PERF_FS_LS]       = "fs_ls",
+    [PERF_FS_MKDIR]    = "fs_mkdir",
+    [PERF_FS_TOUCH]    = "fs_touch",
+    [PERF_FS_CD]       = "fs_cd",
+    [PERF_FS_CAT]      = "fs_cat",
+    [PERF_FS_WRITE]    = "fs_write",
+    [PERF_FS_RM]       = "fs_rm",
+    [PERF_READ_BLOCK]  = "read_block",
+    [PERF_WRITE_BLOCK] = "write_block",
+    [PERF_READAHEAD]   = "readahead",
+    [PERF_BLOCK_CSUM]  = "block_csum",
+    [PERF_FS_WALK]     = "fs_walk",
+    [PERF_FS_READ]     = "fs_read",
+};
+
+const char* perf_op_name(uint32_t op) {
+    return op < PERF_OP_COUNT ? perf_names[op] : "?";
+}
+
+PerfScope perf_scope_begin(uint32_t op) {
+    PerfScope scope = { op, 0, 0 };
+#ifdef CONFIG_BLKTRACE
+    // A E/S de blocos é atribuída à operação que a chamou, não a si mesma
+    scope.prev_op = blktrace_current_op;
+    if (op != PERF_READ_BLOCK && op != PERF_WRITE_BLOCK) {
+        blktrace_current_op = op;
+    }
+#endif
+#ifdef CONFIG_PERF
+    scope.start = timer_cycles();
+#endif
+    return scope;
+}
+
+void perf_scope_end(PerfScope* scope) {
+#ifdef CONFIG_PERF
+    perf_record(scope->op, timer_cycles() - scope->start);
+#endif
+#ifdef CONFIG_BLKTRACE
+    blktrace_current_op = scope->prev_op;
+#endif
+}
+
+#endif
+
+#ifdef CONFIG_PERF
+
+#define PERF_BUCKETS 32
+
+// Estatísticas de uma operação; o bucket i conta durações em [2^i, 2^(i+1))
+typedef struct {
+    uint32_t count;
+    uint64_t total;
+    uint32_t max;
+    uint32_t hist[PERF_BUCKETS];
+} PerfStat;
+
+static PerfStat perf_table[PERF_OP_COUNT];
+
+void perf_init() {
+    timer_cycles_init();
+    memset(perf_table, 0, sizeof(perf_table));
+}
+
+void perf_record(uint32_t op, uint32_t cycles) {
+    PerfStat* s = &perf_table[op];
+    s->count++;
+    s->total += cycles;
+    if (cycles > s->max) s->max = cycles;
+    s->hist[cycles ? 31 - __builtin_clz(cycles) : 0]++;
+}
+
+void perf_report() {
+    uart_puts("--- Latencias por operacao (ciclos) ---\n");
+    for (int op = 0; op < PERF_OP_COUNT; op++) {
+        PerfStat* s = &perf_table[op];
+        if (s->count == 0) continue;
+
+        uart_puts(perf_op_name(op));
+        uart_puts("\n");
+        uart_puts_aligned("  chamadas", s->count, -1, NULL);
+        // Total em unidades de 1024 ciclos para caber em 32 bits
+        uart_puts_aligned("  total", (uint32_t)(s->total >> 10), -1, " Kc");
+        uart_puts_aligned("  maximo", s->max, -1, NULL);
+        for (int b = 0; b < PERF_BUCKETS; b++) {
+            if (s->hist[b] == 0) continue;
+            char label[16] = "  < 2^";
+            char num[8];
+            itoa(b + 1, num);
+            strcat(label, num);
+            uart_puts_aligned(label, s->hist[b], -1, NULL);
+        }
+    }
+    uart_puts("-------------------------------------------\n");
+    memset(perf_table, 0, sizeof(perf_table));
+}
+
+#endif
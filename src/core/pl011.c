@@ -0,0 +1,92 @@
+#include "uart_backend.h"
+#include "common.h"
+
+#define UART0_BASE        (PERIPHERAL_BASE + 0x201000)
+
+// Registradores da PL011 (UART0)
+#define UART0_DR          ((volatile uint32_t*)(UART0_BASE + 0x00))
+#define UART0_FR          ((volatile uint32_t*)(UART0_BASE + 0x18))
+#define UART0_IBRD        ((volatile uint32_t*)(UART0_BASE + 0x24))
+#define UART0_FBRD        ((volatile uint32_t*)(UART0_BASE + 0x28))
+#define UART0_LCRH        ((volatile uint32_t*)(UART0_BASE + 0x2C))
+#define UART0_CR          ((volatile uint32_t*)(UART0_BASE + 0x30))
+#define UART0_IMSC        ((volatile uint32_t*)(UART0_BASE + 0x38))
+#define UART0_ICR         ((volatile uint32_t*)(UART0_BASE + 0x44))
+
+// Bits do registrador de flags
+#define FR_BUSY           (1 << 3)
+#define FR_RXFE           (1 << 4)
+#define FR_TXFF           (1 << 5)
+#define FR_TXFE           (1 << 7)
+
+#define LCRH_FEN          (1 << 4)
+#define LCRH_WLEN_8       (3 << 5)
+#define CR_UARTEN         (1 << 0)
+#define CR_TXE            (1 << 8)
+#define CR_RXE            (1 << 9)
+
+// Relógio de referência da UART, definido pelo firmware (init_uart_clock
+// no config.txt; 48 MHz nos firmwares atuais). O baud máximo é clock / 16.
+#ifndef PL011_CLOCK
+#define PL011_CLOCK       48000000
+#endif
+
+#define PL011_FIFO        16
+
+static uint32_t divisor;    // Em 1/64 avos: IBRD nos bits altos, FBRD nos 6 baixos
+
+static int pl011_init(uint32_t baud) {
+    // divisor = clock / (16 * baud), com 6 bits de fração, arredondado
+    if (baud == 0 || baud > PL011_CLOCK / 16) return -1;
+    uint32_t div = (udiv32(PL011_CLOCK * 8, baud) + 1) / 2;
+    if (div < 64 || div >= (0x10000 << 6)) return -1;
+    divisor = div;
+
+    // Desliga a UART e espera o último byte sair antes de reprogramá-la
+    *UART0_CR = 0;
+    while (*UART0_FR & FR_BUSY);
+    *UART0_LCRH = 0;   // Descarta as FIFOs
+
+    uart_gpio_setup(GPIO_ALT0);
+
+    *UART0_ICR = 0x7FF;
+    *UART0_IBRD = divisor >> 6;
+    *UART0_FBRD = divisor & 63;
+    *UART0_LCRH = LCRH_WLEN_8 | LCRH_FEN;   // 8N1 com FIFOs
+    *UART0_IMSC = 0;                        // Sem interrupções
+    *UART0_CR = CR_UARTEN | CR_TXE | CR_RXE;
+    return 0;
+}
+
+static uint32_t pl011_actual_baud() {
+    return udiv32(PL011_CLOCK * 4, divisor);
+}
+
+// A PL011 não informa o nível da FIFO, só se está vazia ou cheia: com
+// ela vazia, uma rajada de PL011_FIFO bytes cabe sem nova consulta
+static uint32_t pl011_tx_room() {
+    uint32_t fr = *UART0_FR;
+    if (fr & FR_TXFE) return PL011_FIFO;
+    return (fr & FR_TXFF) ? 0 : 1;
+}
+
+static void pl011_tx(unsigned char c) {
+    *UART0_DR = c;
+}
+
+static int pl011_rx_ready() {
+    return !(*UART0_FR & FR_RXFE);
+}
+
+static unsigned char pl011_rx() {
+    return *UART0_DR & 0xFF;
+}
+
+static int pl011_tx_idle() {
+    return (*UART0_FR & (FR_TXFE | FR_BUSY)) == FR_TXFE;
+}
+
+const UartBackend pl011_backend = {
+    "pl011", PL011_FIFO, pl011_init, pl011_actual_baud,
+    pl011_tx_room, pl011_tx, pl011_rx_ready, pl011_rx, pl011_tx_idle,
+};
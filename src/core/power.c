@@ -0,0 +1,25 @@
+#include "power.h"
+#include "uart.h"
+#include <stdint.h>
+
+// Registradores do watchdog no bloco PM (Power Management) do BCM2837
+#define PERIPHERAL_BASE   0x3F000000
+#define PM_RSTC           ((volatile uint32_t*)(PERIPHERAL_BASE + 0x10001C))
+#define PM_WDOG           ((volatile uint32_t*)(PERIPHERAL_BASE + 0x100024))
+
+// Toda escrita no PM precisa da senha nos 8 bits superiores
+#define PM_PASSWORD             0x5A000000
+#define PM_RSTC_WRCFG_CLR       0xFFFFFFCF
+#define PM_RSTC_WRCFG_FULL_RESET 0x00000020
+
+void power_reboot() {
+    // Deixa a última mensagem sair pela UART antes do reset
+    uart_flush();
+
+    // Arma o watchdog com um tempo curto (em ticks de ~16 us) e pede um reset completo
+    *PM_WDOG = PM_PASSWORD | 10;
+    *PM_RSTC = PM_PASSWORD | (*PM_RSTC & PM_RSTC_WRCFG_CLR) | PM_RSTC_WRCFG_FULL_RESET;
+    for (;;) {
+        asm volatile("wfe");
+    }
+}
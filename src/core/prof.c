@@ -0,0 +1,178 @@
+#include "prof.h"
+
+#ifdef CONFIG_PROF
+
+#include "common.h"
+#include "uart.h"
+
+// Controlador de interrupções local do BCM2836/7 (um por núcleo)
+#define LOCAL_BASE             0x40000000
+#define CORE0_TIMER_IRQ_CTRL   ((volatile uint32_t*)(LOCAL_BASE + 0x40))
+#define CORE0_IRQ_SOURCE       ((volatile uint32_t*)(LOCAL_BASE + 0x60))
+#define CNTPNSIRQ              (1 << 1)    // Timer físico, mundo não seguro
+
+// Frequência do contador quando o firmware não programa o CNTFRQ
+#define CNTFRQ_FALLBACK 19200000
+
+// Definida em vectors.s/vectors64.s
+extern char exception_vectors[];
+
+typedef struct {
+    uint32_t pc;    // O kernel fica abaixo de 4 GB nas duas arquiteturas
+    uint32_t lr;
+} ProfSample;
+
+static ProfSample samples[PROF_ENTRIES];
+static volatile uint32_t sample_head;   // Amostras gravadas desde o último start
+static volatile uint32_t spurious;      // IRQs que não vieram do timer
+static uint32_t interval;               // Ticks do contador entre amostras
+static uint32_t sample_hz;
+static int running;
+
+#if defined(__aarch64__)
+
+static uint32_t counter_freq() {
+    uint64_t f;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(f));
+    return (uint32_t)f;
+}
+
+static void timer_arm(uint32_t ticks) {
+    asm volatile("msr cntp_tval_el0, %0" :: "r"((uint64_t)ticks));
+}
+
+// CNTP_CTL: ENABLE (bit 0); IMASK (bit 1) fica zerado
+static void timer_enable(int on) {
+    asm volatile("msr cntp_ctl_el0, %0" :: "r"((uint64_t)(on ? 1 : 0)));
+    asm volatile("isb");
+}
+
+static void set_vbar() {
+    asm volatile("msr vbar_el1, %0" :: "r"((uint64_t)(uintptr_t)exception_vectors));
+    asm volatile("isb");
+}
+
+static void irq_unmask() { asm volatile("msr daifclr, #2" ::: "memory"); }
+static void irq_mask()   { asm volatile("msr daifset, #2" ::: "memory"); }
+
+#else
+
+static uint32_t counter_freq() {
+    uint32_t f;
+    asm volatile("mrc p15, 0, %0, c14, c0, 0" : "=r"(f));
+    return f;
+}
+
+static void timer_arm(uint32_t ticks) {
+    asm volatile("mcr p15, 0, %0, c14, c2, 0" :: "r"(ticks));
+}
+
+static void timer_enable(int on) {
+    asm volatile("mcr p15, 0, %0, c14, c2, 1" :: "r"(on ? 1 : 0));
+    asm volatile("isb");
+}
+
+// Requer SCTLR.V = 0 (vetores baixos), o padrão após o boot
+static void set_vbar() {
+    asm volatile("mcr p15, 0, %0, c12, c0, 0" :: "r"((uint32_t)(uintptr_t)exception_vectors));
+    asm volatile("isb");
+}
+
+static void irq_unmask() { asm volatile("cpsie i" ::: "memory"); }
+static void irq_mask()   { asm volatile("cpsid i" ::: "memory"); }
+
+#endif
+
+void prof_init() {
+    set_vbar();
+    timer_enable(0);
+    *CORE0_TIMER_IRQ_CTRL = CNTPNSIRQ;
+}
+
+int prof_start(uint32_t hz) {
+    if (hz == 0 || hz > PROF_MAX_HZ) return -1;
+    uint32_t freq = counter_freq();
+    if (freq == 0) freq = CNTFRQ_FALLBACK;
+
+    irq_mask();
+    sample_head = 0;
+    spurious = 0;
+    sample_hz = hz;
+    interval = udiv32(freq, hz);
+    timer_arm(interval);
+    timer_enable(1);
+    running = 1;
+    irq_unmask();
+    return 0;
+}
+
+void prof_stop() {
+    irq_mask();
+    timer_enable(0);
+    running = 0;
+}
+
+void prof_irq(uintptr_t pc, uintptr_t lr) {
+    if (!(*CORE0_IRQ_SOURCE & CNTPNSIRQ)) {
+        spurious++;
+        return;
+    }
+    // Rearmar primeiro também baixa a linha de interrupção do timer
+    timer_arm(interval);
+
+    ProfSample* s = &samples[sample_head & (PROF_ENTRIES - 1)];
+    s->pc = (uint32_t)pc;
+    s->lr = (uint32_t)lr;
+    sample_head++;
+}
+
+static uint32_t sample_count() {
+    return sample_head < PROF_ENTRIES ? sample_head : PROF_ENTRIES;
+}
+
+void prof_stat() {
+    uart_puts("--- Profiler por amostragem ---\n");
+    uart_puts_aligned(" Amostragem ativa", running, -1, NULL);
+    uart_puts_aligned(" Frequencia", sample_hz, -1, " Hz");
+    uart_puts_aligned(" Amostras gravadas", sample_head, -1, NULL);
+    uart_puts_aligned(" Amostras no buffer", sample_count(), PROF_ENTRIES, NULL);
+    uart_puts_aligned(" IRQs de outra origem", spurious, -1, NULL);
+    uart_puts("-------------------------------------------\n");
+}
+
+static void put_word(uint32_t w) {
+    uart_putc(w & 0xFF);
+    uart_putc((w >> 8) & 0xFF);
+    uart_putc((w >> 16) & 0xFF);
+    uart_putc((w >> 24) & 0xFF);
+}
+
+void prof_dump() {
+    // Pausa a amostragem para o dump não amostrar a si mesmo
+    int was_running = running;
+    if (was_running) prof_stop();
+
+    uint32_t count = sample_count();
+    uint32_t first = sample_head - count;
+    put_word(PROF_MAGIC);
+    put_word(PROF_VERSION);
+    put_word(count);
+    put_word(sample_hz);
+    put_word(sample_head - count);
+    put_word(sizeof(uintptr_t) * 8);
+    for (uint32_t i = 0; i < count; i++) {
+        ProfSample* s = &samples[(first + i) & (PROF_ENTRIES - 1)];
+        put_word(s->pc);
+        put_word(s->lr);
+    }
+
+    // Retoma sem descartar as amostras
+    if (was_running) {
+        timer_arm(interval);
+        timer_enable(1);
+        running = 1;
+        irq_unmask();
+    }
+}
+
+#endif
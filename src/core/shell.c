@@ -2,13 +2,45 @@
 #include "uart.h"
 #include "common.h"
 #include "sfs.h"
+#include "perf.h"
+#include "blktrace.h"
+#include "prof.h"
+#include "kmem.h"
+#include "power.h"
+#include "dedup.h"
+#include "blksync.h"
+#include "timer.h"
+#include "bench.h"
+#include "flash.h"
+#include "task.h"
 
-#define CMD_BUFFER_SIZE 128
+#define CMD_BUFFER_SIZE 320  // Comporta um nome de MAX_FILENAME_LEN bytes
 #define MAX_ARGS 16
+#define CMD_SEPARATOR ';'
+#define UARTBENCH_BYTES (64 * 1024)
+#define SOURCE_MAX_DEPTH 3
+#define SOURCE_MAX_SIZE (MAX_FILE_BLOCKS * BLOCK_SIZE)   // O maior arquivo possível
+#define JOB_SUFFIX '&'
+
+// Tabela hash de despacho (potência de 2, ao menos o dobro do número de comandos)
+#define DISPATCH_SLOTS 64
+
+typedef struct {
+    const char* name;
+    const char* args;      // Argumentos, para as mensagens de ajuda e uso
+    int min_args;
+    void (*handler)(int argc, char** argv);
+    const char* help;
+} ShellCommand;
 
 static void read_command(char *buffer) {
     int i = 0;
     while (i < CMD_BUFFER_SIZE - 1) {
+        // Enquanto espera, os jobs e o limpador do log trabalham
+        while (!uart_has_input()) {
+            flash_idle();
+            task_yield();
+        }
         char c = uart_getc();
         if (c == '\r' || c == '\n') {
             uart_puts("\n");
@@ -37,103 +69,608 @@ static int parse_command(char *buffer, char **argv) {
     return argc;
 }
 
-static enum {
-    CMD_UNKNOWN,
-    CMD_HELP,
-    CMD_LS,
-    CMD_MKDIR,
-    CMD_TOUCH,
-    CMD_CAT,
-    CMD_WRITE,
-    CMD_CD,
-    CMD_RM,
-    CMD_FORMAT,
-    CMD_STAT
-} resolve_command(const char *cmd) {
-    if (strcmp(cmd, "help") == 0) return CMD_HELP;
-    if (strcmp(cmd, "ls") == 0) return CMD_LS;
-    if (strcmp(cmd, "mkdir") == 0) return CMD_MKDIR;
-    if (strcmp(cmd, "touch") == 0) return CMD_TOUCH;
-    if (strcmp(cmd, "cat") == 0) return CMD_CAT;
-    if (strcmp(cmd, "write") == 0) return CMD_WRITE;
-    if (strcmp(cmd, "cd") == 0) return CMD_CD;
-    if (strcmp(cmd, "rm") == 0) return CMD_RM;
-    if (strcmp(cmd, "format") == 0) return CMD_FORMAT;
-    if (strcmp(cmd, "stat") == 0) return CMD_STAT;
-    return CMD_UNKNOWN;
+static void execute_line(char *line);
+static void execute_command(char *command);
+
+// Assinatura comum a todos os comandos; nem todos usam os argumentos
+#define CMD_HANDLER(name) \
+    static void name(int argc __attribute__((unused)), char** argv __attribute__((unused)))
+
+// HANDLERS DOS COMANDOS
+
+CMD_HANDLER(cmd_help);
+
+CMD_HANDLER(cmd_ls) {
+    fs_ls();
+}
+
+CMD_HANDLER(cmd_mkdir) {
+    fs_mkdir(argv[1]);
+}
+
+CMD_HANDLER(cmd_touch) {
+    fs_touch(argv[1]);
+}
+
+CMD_HANDLER(cmd_cat) {
+    fs_cat(argv[1]);
+}
+
+// Interpreta as sequências de escape do texto de 'write' no próprio buffer:
+// "\n" vira quebra de linha (para montar scripts), "\;" e "\\" viram literais
+static void unescape_text(char* text) {
+    char* out = text;
+    for (char* p = text; *p; p++) {
+        if (*p == '\\' && p[1]) {
+            p++;
+            *out++ = (*p == 'n') ? '\n' : *p;
+        } else {
+            *out++ = *p;
+        }
+    }
+    *out = '\0';
+}
+
+CMD_HANDLER(cmd_write) {
+    // Reconstrói o texto, que foi separado em vários argumentos pelo parser
+    for (int i = 2; i < argc - 1; i++) {
+        char* end = argv[i] + strlen(argv[i]);
+        *end = ' ';
+    }
+    unescape_text(argv[2]);
+    fs_write(argv[1], argv[2]);
+}
+
+CMD_HANDLER(cmd_cd) {
+    fs_cd(argv[1]);
+}
+
+CMD_HANDLER(cmd_rm) {
+    if (strcmp(argv[1], "-r") == 0) {
+        if (argc < 3) {
+            uart_puts("Uso: rm -r <nome>\n");
+            return;
+        }
+        fs_rm_recursive(argv[2]);
+    } else {
+        fs_rm(argv[1]);
+    }
+}
+
+CMD_HANDLER(cmd_du) {
+    fs_du(argc > 1 ? argv[1] : NULL);
+}
+
+CMD_HANDLER(cmd_find) {
+    fs_find(argv[1]);
+}
+
+CMD_HANDLER(cmd_grep) {
+    int recursive = strcmp(argv[1], "-r") == 0;
+    if (argc < 2 + recursive) {
+        uart_puts("Uso: grep [-r] <padrao> [nome]\n");
+        return;
+    }
+    fs_grep(argv[1 + recursive], argc > 2 + recursive ? argv[2 + recursive] : NULL, recursive);
+}
+
+CMD_HANDLER(cmd_format) {
+    uart_puts("Formatando...\n");
+    fs_format();
+    fs_mount();
+    uart_puts("Pronto.\n");
+}
+
+CMD_HANDLER(cmd_reboot) {
+    uart_puts("Reiniciando (o disco em RAM e preservado)...\n");
+    power_reboot();
+}
+
+CMD_HANDLER(cmd_stat) {
+    fs_stat();
+}
+
+CMD_HANDLER(cmd_fsck) {
+    fs_fsck(argc > 1 && strcmp(argv[1], "-r") == 0);
+}
+
+// Remonta o disco, com o fsck opcional da montagem
+CMD_HANDLER(cmd_mount) {
+    uint32_t opts = MOUNT_DEFAULT_OPTS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0) {
+            opts |= MOUNT_CHECK;
+        } else if (strcmp(argv[i], "-r") == 0) {
+            opts |= MOUNT_CHECK | MOUNT_REPAIR;
+        } else {
+            uart_puts("Uso: mount [-c] [-r]\n");
+            return;
+        }
+    }
+    if (fs_mount_opts(opts)) {
+        uart_puts("Sistema de arquivos formatado e montado.\n");
+    } else {
+        uart_puts("Sistema de arquivos montado.\n");
+    }
+}
+
+CMD_HANDLER(cmd_perf) {
+#ifdef CONFIG_PERF
+    perf_report();
+#else
+    uart_puts("Instrumentacao desativada (compile com PERF=1).\n");
+#endif
+}
+
+CMD_HANDLER(cmd_blktrace) {
+#ifdef CONFIG_BLKTRACE
+    if (argc < 2) {
+        blktrace_stat();
+    } else if (strcmp(argv[1], "on") == 0) {
+        blktrace_enable(1);
+    } else if (strcmp(argv[1], "off") == 0) {
+        blktrace_enable(0);
+    } else if (strcmp(argv[1], "clear") == 0) {
+        blktrace_clear();
+    } else if (strcmp(argv[1], "dump") == 0) {
+        blktrace_dump();
+        uart_puts("\n");
+    } else {
+        uart_puts("Uso: blktrace [on|off|clear|dump]\n");
+    }
+#else
+    uart_puts("Rastreio desativado (compile com BLKTRACE=1).\n");
+#endif
+}
+
+CMD_HANDLER(cmd_prof) {
+#ifdef CONFIG_PROF
+    if (argc < 2) {
+        prof_stat();
+    } else if (strcmp(argv[1], "start") == 0) {
+        uint32_t hz = PROF_DEFAULT_HZ;
+        if ((argc > 2 && parse_uint(argv[2], &hz) != 0) || prof_start(hz) != 0) {
+            uart_puts("Uso: prof start [hz] (1 a 20000)\n");
+        }
+    } else if (strcmp(argv[1], "stop") == 0) {
+        prof_stop();
+    } else if (strcmp(argv[1], "dump") == 0) {
+        prof_dump();
+        uart_puts("\n");
+    } else {
+        uart_puts("Uso: prof [start [hz]|stop|dump]\n");
+    }
+#else
+    uart_puts("Profiler desativado (compile com PROF=1).\n");
+#endif
+}
+
+CMD_HANDLER(cmd_mem) {
+    kmem_stat();
+}
+
+CMD_HANDLER(cmd_dedup) {
+    if (argc >= 2 && strcmp(argv[1], "on") == 0) {
+        dedup_set_enabled(1);
+        if (!dedup_enabled()) uart_puts("Erro: Memoria insuficiente para o indice.\n");
+    } else if (argc >= 2 && strcmp(argv[1], "off") == 0) {
+        dedup_set_enabled(0);
+    } else if (argc >= 2) {
+        uart_puts("Uso: dedup [on|off]\n");
+        return;
+    }
+    uart_puts(dedup_enabled() ? "Deduplicacao ligada.\n" : "Deduplicacao desligada.\n");
+}
+
+CMD_HANDLER(cmd_export) {
+    int full = argc > 1 && strcmp(argv[1], "-a") == 0;
+    char buf[12];
+    itoa(blksync_export(full), buf);
+    uart_puts("\nExportados ");
+    uart_puts(buf);
+    uart_puts(" blocos.\n");
+}
+
+CMD_HANDLER(cmd_import) {
+    int applied = blksync_import();
+    if (applied < 0) return;
+    char buf[12];
+    itoa(applied, buf);
+    uart_puts("Importados ");
+    uart_puts(buf);
+    uart_puts(" blocos.\n");
+}
+
+CMD_HANDLER(cmd_uart) {
+    if (argc >= 2) {
+        int backend = strcmp(argv[1], "pl011") == 0 ? UART_PL011
+                    : strcmp(argv[1], "mini") == 0 ? UART_MINI : -1;
+        uint32_t baud = uart_baud();
+        if (backend == -1 || (argc >= 3 && parse_uint(argv[2], &baud) != 0)) {
+            uart_puts("Uso: uart [mini|pl011] [baud]\n");
+            return;
+        }
+        if (uart_configure(backend, baud) != 0) {
+            uart_puts("Erro: Baud inalcancavel neste controlador.\n");
+            return;
+        }
+    }
+    uart_puts("--- Console serial ---\n");
+    uart_stat();
+    uart_puts("-------------------------------------------\n");
+}
+
+// Mede a vazão do console enviando um arquivo (ou 64 KB de linhas de teste).
+// Conta os bytes na linha, incluindo o '\r' acrescentado a cada '\n'.
+CMD_HANDLER(cmd_uartbench) {
+    char chunk[512];
+    uint32_t wire_bytes = 0;
+
+    if (argc > 1 && fs_read(argv[1], 0, chunk, 0) < 0) {
+        uart_puts("Arquivo nao encontrado.\n");
+        return;
+    }
+
+    uart_flush();
+    uint32_t start = timer_now_us();
+    if (argc > 1) {
+        uint32_t offset = 0;
+        int n;
+        while ((n = fs_read(argv[1], offset, chunk, sizeof(chunk))) > 0) {
+            uart_write(chunk, n);
+            for (int i = 0; i < n; i++) wire_bytes += chunk[i] == '\n' ? 2 : 1;
+            offset += n;
+        }
+    } else {
+        for (int i = 0; i < 62; i++) chunk[i] = '!' + i;
+        chunk[62] = '\r';
+        chunk[63] = '\n';
+        for (wire_bytes = 0; wire_bytes < UARTBENCH_BYTES; wire_bytes += 64) {
+            uart_write_raw(chunk, 64);
+        }
+    }
+    uart_flush();
+    uint32_t elapsed = timer_now_us() - start;
+
+    // A linha transmite 10 bits por byte (8N1)
+    uint32_t ms = elapsed / 1000 ? elapsed / 1000 : 1;
+    uint32_t rate = udiv32(wire_bytes * 1000, ms);
+    uint32_t line_rate = uart_baud() / 10;
+
+    uart_puts("\n--- Vazao do console ---\n");
+    uart_stat();
+    uart_puts_aligned(" Bytes enviados", wire_bytes, -1, " Bytes");
+    uart_puts_aligned(" Tempo", elapsed, -1, " us");
+    uart_puts_aligned(" Vazao", rate, -1, " B/s");
+    uart_puts_aligned(" Limite da linha", line_rate, -1, " B/s");
+    uart_puts_aligned(" Eficiencia", udiv32(rate * 100, line_rate), -1, " %");
+    uart_puts("-------------------------------------------\n");
+}
+
+CMD_HANDLER(cmd_bench) {
+    uint32_t files = BENCH_DEFAULT_FILES;
+    if (argc > 1 && parse_uint(argv[1], &files) != 0) {
+        uart_puts("Uso: bench [arquivos]\n");
+        return;
+    }
+    fs_bench(files);
+}
+
+CMD_HANDLER(cmd_flash) {
+    static const char* const layouts[] = { "off", "inplace", "log" };
+    if (argc < 2) {
+        flash_sync();
+        uart_puts("--- Dispositivo flash ---\n");
+        flash_stat();
+        uart_puts("-------------------------------------------\n");
+        return;
+    }
+    for (int l = FLASH_OFF; l <= FLASH_LOG; l++) {
+        if (strcmp(argv[1], layouts[l]) != 0) continue;
+        if (flash_set_layout(l) != 0) uart_puts("Erro: Memoria insuficiente para o dispositivo.\n");
+        return;
+    }
+
+    char buf[12];
+    if (strcmp(argv[1], "sync") == 0) {
+        itoa(flash_sync(), buf);
+        uart_puts("Sincronizados ");
+        uart_puts(buf);
+        uart_puts(" blocos.\n");
+    } else if (strcmp(argv[1], "clean") == 0) {
+        flash_sync();
+        itoa(flash_clean(FLASH_CLEAN_HIGH), buf);
+        uart_puts("Segmentos limpos: ");
+        uart_puts(buf);
+        uart_puts("\n");
+    } else if (strcmp(argv[1], "verify") == 0) {
+        if (flash_layout() != FLASH_LOG) {
+            uart_puts("Erro: O layout atual nao e 'log'.\n");
+            return;
+        }
+        flash_sync();
+        int bad = flash_verify();
+        if (bad < 0) {
+            uart_puts("Erro: Nenhum checkpoint valido.\n");
+        } else if (bad > 0) {
+            uart_puts_aligned("Blocos divergentes", bad, -1, NULL);
+        } else {
+            uart_puts("Log consistente com o disco.\n");
+        }
+    } else if (strcmp(argv[1], "bench") == 0) {
+        uint32_t rounds = BENCH_FLASH_DEFAULT_ROUNDS;
+        if (argc > 2 && parse_uint(argv[2], &rounds) != 0) {
+            uart_puts("Uso: flash bench [rodadas]\n");
+            return;
+        }
+        fs_bench_flash(rounds);
+    } else {
+        uart_puts("Uso: flash [off|inplace|log|sync|clean|verify|bench [rodadas]]\n");
+    }
+}
+
+CMD_HANDLER(cmd_jobs) {
+    uart_puts("--- Tarefas ---\n");
+    task_list();
+    uart_puts("-------------------------------------------\n");
+}
+
+// Profundidade de 'source' de cada tarefa: um job em segundo plano tem a sua
+static int source_depth[TASK_MAX];
+
+// Executa um script armazenado no sistema de arquivos, uma linha por vez,
+// sem prompt nem eco. Linhas iniciadas por '#' são comentários. O script é
+// lido inteiro antes da primeira linha: os comandos dele podem trocar o
+// diretório atual (ou alterar o próprio arquivo).
+CMD_HANDLER(cmd_source) {
+    if (source_depth[task_current()] >= SOURCE_MAX_DEPTH) {
+        uart_puts("Erro: 'source' aninhado demais.\n");
+        return;
+    }
+
+    char* script = kmalloc(SOURCE_MAX_SIZE);
+    if (!script) {
+        uart_puts("Erro: Memoria insuficiente para o script.\n");
+        return;
+    }
+    int size = fs_read(argv[1], 0, script, SOURCE_MAX_SIZE);
+    if (size < 0) {
+        uart_puts("Erro: Script nao encontrado: ");
+        uart_puts(argv[1]);
+        uart_puts("\n");
+        kfree(script);
+        return;
+    }
+
+    char line[CMD_BUFFER_SIZE];
+    int len = 0;
+    source_depth[task_current()]++;
+    for (int i = 0; i <= size; i++) {
+        char c = i < size ? script[i] : '\n';   // A última linha pode não ter '\n'
+        if (c != '\n' && c != '\r') {
+            if (len < CMD_BUFFER_SIZE - 1) line[len++] = c;
+            continue;
+        }
+        line[len] = '\0';
+        if (len > 0 && line[0] != '#') execute_line(line);
+        len = 0;
+    }
+    source_depth[task_current()]--;
+    kfree(script);
+}
+
+static const ShellCommand commands[] = {
+    { "help",      "",            0, cmd_help,      "Mostra esta ajuda" },
+    { "ls",        "",            0, cmd_ls,        "Lista arquivos e diretorios" },
+    { "mkdir",     "<nome>",      1, cmd_mkdir,     "Cria um novo diretorio" },
+    { "touch",     "<nome>",      1, cmd_touch,     "Cria um novo arquivo vazio" },
+    { "cat",       "<arquivo>",   1, cmd_cat,       "Mostra o conteudo de um arquivo" },
+    { "write",     "<f> <texto>", 2, cmd_write,     "Escreve/anexa texto ao arquivo <f>" },
+    { "cd",        "<diretorio>", 1, cmd_cd,        "Muda de diretorio (use '..' para voltar)" },
+    { "rm",        "[-r] <nome>", 1, cmd_rm,        "Deleta um arquivo ou diretorio (-r: e o conteudo)" },
+    { "du",        "[nome]",      0, cmd_du,        "Mostra o espaco ocupado por uma subarvore" },
+    { "find",      "<nome>",      1, cmd_find,      "Procura <nome> abaixo do diretorio atual" },
+    { "grep",      "[-r] <padrao> [nome]", 1, cmd_grep, "Mostra as linhas com <padrao> nos arquivos (-r: em subdiretorios)" },
+    { "stat",      "",            0, cmd_stat,      "Mostra estatisticas de uso do disco" },
+    { "format",    "",            0, cmd_format,    "Re-formata o sistema de arquivos" },
+    { "reboot",    "",            0, cmd_reboot,    "Reinicia a placa mantendo o disco" },
+    { "fsck",      "[-r]",        0, cmd_fsck,      "Verifica (e corrige com -r) o sistema" },
+    { "mount",     "[-c] [-r]",   0, cmd_mount,     "Remonta o disco (-c: com fsck, -r: e corrige)" },
+    { "export",    "[-a]",        0, cmd_export,    "Envia os blocos alterados (-a: todos) pela serial" },
+    { "import",    "",            0, cmd_import,    "Recebe e aplica um fluxo de 'export'" },
+    { "source",    "<arquivo>",   1, cmd_source,    "Executa os comandos de um arquivo" },
+    { "mem",       "",            0, cmd_mem,       "Mostra o uso e a fragmentacao do heap" },
+    { "dedup",     "[on|off]",    0, cmd_dedup,     "Liga/desliga a deduplicacao de blocos" },
+    { "uart",      "[ctl] [baud]", 0, cmd_uart,     "Console: mostra ou troca (mini, pl011) e o baud" },
+    { "uartbench", "[arquivo]",   0, cmd_uartbench, "Mede a vazao do console enviando um arquivo" },
+    { "bench",     "[arquivos]",  0, cmd_bench,     "Mede o sistema de arquivos (linhas BENCH)" },
+    { "flash",     "[op]",        0, cmd_flash,     "Dispositivo flash: off, inplace, log, sync, clean, verify, bench" },
+    { "jobs",      "",            0, cmd_jobs,      "Lista as tarefas ('<comando> &' roda em segundo plano)" },
+    { "perf",      "",            0, cmd_perf,      "Mostra e zera as latencias por operacao" },
+    { "blktrace",  "[op]",        0, cmd_blktrace,  "Rastreio de blocos: on, off, clear, dump" },
+    { "prof",      "[op]",        0, cmd_prof,      "Profiler por amostragem: start [hz], stop, dump" },
+};
+
+#define NUM_COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+CMD_HANDLER(cmd_help) {
+    uart_puts("Comandos disponiveis:\n");
+    for (uint32_t i = 0; i < NUM_COMMANDS; i++) {
+        uart_puts("  ");
+        uart_puts(commands[i].name);
+        uart_puts(" ");
+        uart_puts(commands[i].args);
+        for (int pad = strlen(commands[i].name) + strlen(commands[i].args); pad < 20; pad++) {
+            uart_puts(" ");
+        }
+        uart_puts("- ");
+        uart_puts(commands[i].help);
+        uart_puts("\n");
+    }
+    uart_puts("Separe varios comandos na mesma linha com ';'.\n");
+    uart_puts("Em 'write', use \\n para quebrar linha e \\; para um ';' literal.\n");
+}
+
+// DESPACHO
+
+static const ShellCommand* dispatch_table[DISPATCH_SLOTS];
+
+static uint32_t hash_name(const char* s) {
+    uint32_t h = 5381;
+    while (*s) h = h * 33 + (unsigned char)*s++;
+    return h;
+}
+
+// Indexa os comandos por hash do nome (sondagem linear), de modo que a
+// resolução custa um hash e, em geral, uma única comparação de strings.
+static void build_dispatch_table() {
+    for (uint32_t i = 0; i < NUM_COMMANDS; i++) {
+        uint32_t slot = hash_name(commands[i].name) & (DISPATCH_SLOTS - 1);
+        while (dispatch_table[slot]) slot = (slot + 1) & (DISPATCH_SLOTS - 1);
+        dispatch_table[slot] = &commands[i];
+    }
+}
+
+static const ShellCommand* resolve_command(const char *cmd) {
+    uint32_t slot = hash_name(cmd) & (DISPATCH_SLOTS - 1);
+    while (dispatch_table[slot]) {
+        if (strcmp(dispatch_table[slot]->name, cmd) == 0) return dispatch_table[slot];
+        slot = (slot + 1) & (DISPATCH_SLOTS - 1);
+    }
+    return NULL;
+}
+
+// Comandos que trocam o disco inteiro (ou reiniciam a placa) por baixo das
+// outras tarefas: não rodam em segundo plano nem com jobs em execução
+static int is_exclusive(int argc, char** argv) {
+    static const char* const names[] = { "format", "mount", "import", "bench", "flash", "reboot" };
+    for (uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(argv[0], names[i]) == 0) return 1;
+    }
+    return strcmp(argv[0], "fsck") == 0 && argc > 1 && strcmp(argv[1], "-r") == 0;
+}
+
+// Remove um '&' final (e os espaços em volta); devolve 1 se havia um
+static int strip_job_suffix(char* command) {
+    int len = strlen(command);
+    while (len > 0 && command[len - 1] == ' ') len--;
+    if (len == 0 || command[len - 1] != JOB_SUFFIX) return 0;
+    len--;
+    while (len > 0 && command[len - 1] == ' ') len--;
+    command[len] = '\0';
+    return 1;
+}
+
+typedef struct {
+    int id;
+    char line[CMD_BUFFER_SIZE];   // Consumida por parse_command
+    char text[CMD_BUFFER_SIZE];   // Para a mensagem de conclusão
+} Job;
+
+static void run_job(void* arg) {
+    Job* job = arg;
+    execute_command(job->line);
+    flash_sync();
+
+    char buf[12];
+    itoa(job->id, buf);
+    uart_puts("[");
+    uart_puts(buf);
+    uart_puts("] Concluido: ");
+    uart_puts(job->text);
+    uart_puts("\n");
+    kfree(job);
+}
+
+static void start_job(const char* command) {
+    Job* job = kmalloc(sizeof(Job));
+    if (!job) {
+        uart_puts("Erro: Memoria insuficiente para o job.\n");
+        return;
+    }
+    uint32_t len = strlen(command) + 1;
+    memcpy(job->line, command, len);
+    memcpy(job->text, command, len);
+    job->id = task_spawn(command, run_job, job);
+    if (job->id < 0) {
+        uart_puts("Erro: Limite de tarefas atingido ou memoria insuficiente.\n");
+        kfree(job);
+        return;
+    }
+    char buf[12];
+    itoa(job->id, buf);
+    uart_puts("[");
+    uart_puts(buf);
+    uart_puts("] ");
+    uart_puts(command);
+    uart_puts("\n");
+}
+
+static void execute_command(char *command) {
+    char copy[CMD_BUFFER_SIZE];
+    int background = strip_job_suffix(command);
+    if (background) memcpy(copy, command, strlen(command) + 1);
+
+    char* argv[MAX_ARGS];
+    int argc = parse_command(command, argv);
+    if (argc == 0) return;
+
+    const ShellCommand* cmd = resolve_command(argv[0]);
+    if (!cmd) {
+        uart_puts("Comando desconhecido: ");
+        uart_puts(argv[0]);
+        uart_puts("\nUse 'help' para ver a lista de comandos.\n");
+        return;
+    }
+    if (argc - 1 < cmd->min_args) {
+        uart_puts("Uso: ");
+        uart_puts(cmd->name);
+        uart_puts(" ");
+        uart_puts(cmd->args);
+        uart_puts("\n");
+        return;
+    }
+    if (is_exclusive(argc, argv) && (background || task_count() > 0 || task_current() != 0)) {
+        uart_puts("Erro: '");
+        uart_puts(cmd->name);
+        uart_puts("' nao roda junto com jobs (veja 'jobs').\n");
+        return;
+    }
+    if (background) {
+        start_job(copy);
+        return;
+    }
+    cmd->handler(argc, argv);
+}
+
+// Executa cada comando de uma linha separada por ';' (exceto se escapado)
+static void execute_line(char *line) {
+    char *start = line;
+    for (char *p = line; ; p++) {
+        if (*p == '\\' && p[1]) {
+            p++;
+        } else if (*p == CMD_SEPARATOR || *p == '\0') {
+            int last = (*p == '\0');
+            *p = '\0';
+            execute_command(start);
+            if (last) break;
+            start = p + 1;
+        }
+    }
 }
 
 void shell_start() {
     char cmd_buffer[CMD_BUFFER_SIZE];
-    char* argv[MAX_ARGS];
-    int argc;
+
+    build_dispatch_table();
 
     while (1) {
         uart_puts("SimpleFS:");
         uart_puts(fs_get_current_path());
         uart_puts("$ ");
         read_command(cmd_buffer);
-        argc = parse_command(cmd_buffer, argv);
-
-        if (argc == 0) continue;
-
-        switch (resolve_command(argv[0])) {
-            case CMD_HELP:
-                uart_puts("Comandos disponiveis:\n");
-                uart_puts("  ls             - Lista arquivos e diretorios\n");
-                uart_puts("  mkdir <n>      - Cria um novo diretorio\n");
-                uart_puts("  touch <n>      - Cria um novo arquivo vazio\n");
-                uart_puts("  cat <n>        - Mostra o conteudo de um arquivo\n");
-                uart_puts("  write <f> <t>  - Escreve/anexa texto <t> ao arquivo <f>\n");
-                uart_puts("  cd <n>         - Muda de diretorio (use '..' para voltar)\n");
-                uart_puts("  rm <n>         - Deleta um arquivo ou diretorio vazio\n");
-                uart_puts("  stat           - Mostra estatisticas de uso do disco\n");
-                uart_puts("  format         - Re-formata o sistema de arquivos\n");
-                break;
-            case CMD_LS:
-                fs_ls();
-                break;
-            case CMD_MKDIR:
-                argc > 1 ? fs_mkdir(argv[1]) : uart_puts("Uso: mkdir <nome>\n");
-                break;
-            case CMD_TOUCH:
-                argc > 1 ? fs_touch(argv[1]) : uart_puts("Uso: touch <nome>\n");
-                break;
-            case CMD_CAT:
-                argc > 1 ? fs_cat(argv[1]) : uart_puts("Uso: cat <arquivo>\n");
-                break;
-            case CMD_WRITE:
-                if (argc > 2) {
-                    for (int i = 2; i < argc - 1; i++) {
-                        char* end = argv[i] + strlen(argv[i]);
-                        *end = ' ';
-                    }
-                    fs_write(argv[1], argv[2]);
-                } else {
-                    uart_puts("Uso: write <arquivo> <texto>\n");
-                }
-                break;
-            case CMD_CD:
-                argc > 1 ? fs_cd(argv[1]) : uart_puts("Uso: cd <diretorio>\n");
-                break;
-            case CMD_RM:
-                argc > 1 ? fs_rm(argv[1]) : uart_puts("Uso: rm <nome>\n");
-                break;
-            case CMD_FORMAT:
-                uart_puts("Formatando...\n");
-                fs_format();
-                fs_mount();
-                uart_puts("Pronto.\n");
-                break;
-            case CMD_STAT:
-                fs_stat();
-                break;
-            case CMD_UNKNOWN:
-            default:
-                uart_puts("Comando desconhecido: ");
-                uart_puts(argv[0]);
-                uart_puts("\nUse 'help' para ver a lista de comandos.\n");
-                break;
-        }
+        execute_line(cmd_buffer);
+        // Cada linha de comandos termina gravada no dispositivo flash
+        flash_sync();
     }
 }
@@ -0,0 +1,166 @@
+#include "task.h"
+#include "common.h"
+#include "uart.h"
+#include "kmem.h"
+#include "timer.h"
+#include "fs_defs.h"
+
+#define TASK_STACK_SIZE (TASK_STACK_PAGES * PAGE_SIZE)
+
+// Padrão gravado na pilha nova; o que sobrar intacto nunca foi usado
+#define STACK_FILL 0x5A
+
+// Quadro salvo por task_switch, do endereço mais baixo ao mais alto; o
+// endereço de retorno é sempre a última palavra
+#if defined(__aarch64__)
+#define SWITCH_FRAME_WORDS 20   // d8-d15, x19-x29 e x30 (lr)
+#elif defined(__arm__)
+#define SWITCH_FRAME_WORDS 9    // r4-r11 e lr
+#else
+#define SWITCH_FRAME_WORDS 7    // Build para o host (x86-64): rbx, rbp, r12-r15 e o retorno
+#endif
+
+enum { TASK_FREE, TASK_READY, TASK_DONE };
+
+typedef struct {
+    uintptr_t sp;               // Válido enquanto a tarefa não está rodando
+    int state;
+    uint8_t* stack;             // NULL para o shell, que usa a pilha do boot
+    void (*entry)(void* arg);
+    void* arg;
+    FsContext* fs;              // fs_ctx da tarefa enquanto ela não roda
+    FsContext own_fs;
+    uint32_t switches;
+    uint32_t started_us;
+    char name[TASK_NAME_LEN];
+} Task;
+
+static Task tasks[TASK_MAX] = { [0] = { .state = TASK_READY, .name = "shell" } };
+static uint32_t current = 0;
+static uint32_t spawned = 0;    // Tarefas além do shell, prontas ou terminando
+
+// Libera as pilhas das tarefas que terminaram. Não pode ser feito pela
+// própria tarefa, que ainda roda nela ao chamar task_switch.
+static void reap() {
+    for (uint32_t i = 1; i < TASK_MAX; i++) {
+        if (tasks[i].state != TASK_DONE || i == current) continue;
+        kmem_free_pages(tasks[i].stack);
+        tasks[i].stack = NULL;
+        tasks[i].state = TASK_FREE;
+    }
+}
+
+static void switch_to(uint32_t next) {
+    Task* prev = &tasks[current];
+    prev->fs = fs_ctx;
+    fs_ctx = tasks[next].fs;
+    tasks[next].switches++;
+    current = next;
+    task_switch(&prev->sp, tasks[next].sp);
+    reap();
+}
+
+static uint32_t next_ready() {
+    uint32_t i = current;
+    do {
+        i = (i + 1) % TASK_MAX;
+    } while (tasks[i].state != TASK_READY);
+    return i;
+}
+
+// Primeira função de toda tarefa nova, alcançada pelo retorno de task_switch
+static void task_start() {
+    reap();
+    Task* t = &tasks[current];
+    t->entry(t->arg);
+
+    t->state = TASK_DONE;
+    spawned--;
+    switch_to(next_ready());   // O shell está sempre pronto; não volta
+}
+
+int task_spawn(const char* name, void (*entry)(void* arg), void* arg) {
+    uint32_t id = 1;
+    while (id < TASK_MAX && tasks[id].state != TASK_FREE) id++;
+    if (id == TASK_MAX) return -1;
+    uint8_t* stack = kmem_alloc_pages(TASK_STACK_PAGES);
+    if (!stack) return -1;
+    memset(stack, STACK_FILL, TASK_STACK_SIZE);
+
+    Task* t = &tasks[id];
+    uint32_t len = strlen(name);
+    if (len > TASK_NAME_LEN - 1) len = TASK_NAME_LEN - 1;
+    memcpy(t->name, name, len);
+    t->name[len] = '\0';
+    t->stack = stack;
+    t->entry = entry;
+    t->arg = arg;
+    t->own_fs = *fs_ctx;
+    t->fs = &t->own_fs;
+    t->switches = 0;
+    t->started_us = timer_now_us();
+
+    // Quadro inicial: registradores zerados e retorno para task_start
+    uintptr_t* frame = (uintptr_t*)(stack + TASK_STACK_SIZE) - SWITCH_FRAME_WORDS;
+    memset(frame, 0, SWITCH_FRAME_WORDS * sizeof(uintptr_t));
+    frame[SWITCH_FRAME_WORDS - 1] = (uintptr_t)task_start;
+    t->sp = (uintptr_t)frame;
+    t->state = TASK_READY;
+    spawned++;
+    return id;
+}
+
+void task_yield() {
+    if (spawned == 0) return;
+    uint32_t next = next_ready();
+    if (next != current) switch_to(next);
+}
+
+uint32_t task_count() {
+    return spawned;
+}
+
+uint32_t task_current() {
+    return current;
+}
+
+int task_uses_dir(uint32_t inode_num) {
+    for (uint32_t i = 0; i < TASK_MAX; i++) {
+        if (tasks[i].state != TASK_READY) continue;
+        // O contexto da tarefa em execução está em fs_ctx, não em tasks[i].fs
+        const FsContext* ctx = (i == current) ? fs_ctx : tasks[i].fs;
+        if (ctx->cwd_inode == inode_num) return 1;
+    }
+    return 0;
+}
+
+// Bytes da pilha já usados: do topo até o primeiro byte fora do padrão
+static uint32_t stack_used(const Task* t) {
+    uint32_t untouched = 0;
+    while (untouched < TASK_STACK_SIZE && t->stack[untouched] == STACK_FILL) untouched++;
+    return TASK_STACK_SIZE - untouched;
+}
+
+void task_list() {
+    char buf[12];
+    uint32_t now = timer_now_us();
+    uart_puts("  ID  TROCAS   TEMPO(ms)  PILHA  NOME\n");
+    for (uint32_t i = 0; i < TASK_MAX; i++) {
+        const Task* t = &tasks[i];
+        if (t->state != TASK_READY) continue;
+        uart_puts_right_aligned(i, 4);
+        uart_puts_right_aligned(t->switches, 8);
+        uart_puts_right_aligned(i ? (now - t->started_us) / 1000 : 0, 12);
+        if (t->stack) {
+            uart_puts_right_aligned(stack_used(t), 7);
+        } else {
+            uart_puts("      -");
+        }
+        uart_puts("  ");
+        uart_puts(t->name);
+        uart_puts(i == current ? " (atual)\n" : "\n");
+    }
+    itoa(spawned, buf);
+    uart_puts(buf);
+    uart_puts(" tarefa(s) em segundo plano.\n");
+}
@@ -0,0 +1,56 @@
+#include "timer.h"
+#include <stdint.h>
+
+// Endereços de memória (MMIO) do System Timer da Raspberry Pi 2/3
+#define PERIPHERAL_BASE   0x3F000000
+#define SYSTIMER_BASE     (PERIPHERAL_BASE + 0x3000)
+
+// Registradores do System Timer
+#define SYSTIMER_CLO      ((volatile uint32_t*)(SYSTIMER_BASE + 0x04))
+
+uint32_t timer_now_us() {
+    return *SYSTIMER_CLO;
+}
+
+#if defined(__aarch64__)
+
+void timer_cycles_init() {
+    uint64_t pmcr;
+
+    // PMCR_EL0: E (bit 0) habilita os contadores, C (bit 2) zera o PMCCNTR_EL0
+    asm volatile("mrs %0, pmcr_el0" : "=r"(pmcr));
+    pmcr |= (1 << 0) | (1 << 2);
+    asm volatile("msr pmcr_el0, %0" :: "r"(pmcr));
+
+    // PMCNTENSET_EL0: bit 31 habilita o contador de ciclos
+    asm volatile("msr pmcntenset_el0, %0" :: "r"((uint64_t)1 << 31));
+}
+
+// O contador tem 64 bits no AArch64; a interface usa só os 32 inferiores
+uint32_t timer_cycles() {
+    uint64_t cycles;
+    asm volatile("mrs %0, pmccntr_el0" : "=r"(cycles));
+    return (uint32_t)cycles;
+}
+
+#else
+
+void timer_cycles_init() {
+    uint32_t pmcr;
+
+    // PMCR: E (bit 0) habilita os contadores, C (bit 2) zera o PMCCNTR
+    asm volatile("mrc p15, 0, %0, c9, c12, 0" : "=r"(pmcr));
+    pmcr |= (1 << 0) | (1 << 2);
+    asm volatile("mcr p15, 0, %0, c9, c12, 0" :: "r"(pmcr));
+
+    // PMCNTENSET: bit 31 habilita o contador de ciclos
+    asm volatile("mcr p15, 0, %0, c9, c12, 1" :: "r"(1u << 31));
+}
+
+uint32_t timer_cycles() {
+    uint32_t cycles;
+    asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(cycles));
+    return cycles;
+}
+
+#endif
@@ -1,40 +1,44 @@
 #include "uart.h"
+#include "uart_backend.h"
 #include <stdint.h>
 
-// Endereços de memória (MMIO) para os periféricos da Raspberry Pi 2/3
-#define PERIPHERAL_BASE   0x3F000000
-#define GPIO_BASE         (PERIPHERAL_BASE + 0x200000)
-#define AUX_BASE          (PERIPHERAL_BASE + 0x215000)
-
 // Registradores GPIO
 #define GPFSEL1           ((volatile uint32_t*)(GPIO_BASE + 0x04))
 #define GPPUD             ((volatile uint32_t*)(GPIO_BASE + 0x94))
 #define GPPUDCLK0         ((volatile uint32_t*)(GPIO_BASE + 0x98))
 
-// Registradores Auxiliares e Mini UART
-#define AUX_ENABLES       ((volatile uint32_t*)(AUX_BASE + 0x04))
-#define AUX_MU_IO_REG     ((volatile uint32_t*)(AUX_BASE + 0x40))
-#define AUX_MU_IER_REG    ((volatile uint32_t*)(AUX_BASE + 0x44))
-#define AUX_MU_IIR_REG    ((volatile uint32_t*)(AUX_BASE + 0x48))
-#define AUX_MU_LCR_REG    ((volatile uint32_t*)(AUX_BASE + 0x4C))
-#define AUX_MU_MCR_REG    ((volatile uint32_t*)(AUX_BASE + 0x50))
-#define AUX_MU_LSR_REG    ((volatile uint32_t*)(AUX_BASE + 0x54))
-#define AUX_MU_CNTL_REG   ((volatile uint32_t*)(AUX_BASE + 0x60))
-#define AUX_MU_BAUD_REG   ((volatile uint32_t*)(AUX_BASE + 0x68))
-
-// Função para criar um atraso (delay) simples
+// Controlador e baud escolhidos no build (make UART=pl011 UART_BAUD=...)
+#ifdef CONFIG_UART_PL011
+#define UART_DEFAULT_BACKEND UART_PL011
+#else
+#define UART_DEFAULT_BACKEND UART_MINI
+#endif
+#ifndef CONFIG_UART_BAUD
+#define CONFIG_UART_BAUD 115200
+#endif
+
+static const UartBackend* const backends[] = { &mini_uart_backend, &pl011_backend };
+static const UartBackend* uart = &mini_uart_backend;
+static int current_backend = UART_MINI;
+static uint32_t requested_baud = 115200;   // O baud pedido, refeito ao mudar o relógio
+static int uart_ready = 0;
+static int uart_muted = 0;
+
+// Função para criar um atraso (delay) simples; o "nop" existe nos dois
+// conjuntos de instruções e impede o compilador de remover o laço
 void delay(int32_t count) {
-    asm volatile("__delay_%=: subs %[count], %[count], #1; bne __delay_%=\n"
-         : "=r"(count): [count]"0"(count) : "cc");
+    while (count-- > 0) {
+        asm volatile("nop");
+    }
 }
 
-void uart_init() {
+void uart_gpio_setup(uint32_t alt) {
     uint32_t selector;
 
-    // Configura os pinos GPIO 14 e 15 para a função ALT5 da Mini UART
+    // Configura os pinos GPIO 14 e 15 para a função alternativa
     selector = *GPFSEL1;
     selector &= ~((7 << 12) | (7 << 15)); // Limpa os bits para GPIO 14 e 15
-    selector |= (2 << 12) | (2 << 15);    // Define ALT5 para GPIO 14 e 15
+    selector |= (alt << 12) | (alt << 15);
     *GPFSEL1 = selector;
 
     // Desabilita resistores de pull-up/pull-down para os pinos 14 e 15
@@ -43,45 +47,130 @@ void uart_init() {
     *GPPUDCLK0 = (1 << 14) | (1 << 15);
     delay(150);
     *GPPUDCLK0 = 0;
+}
+
+void uart_init() {
+    if (uart_configure(UART_DEFAULT_BACKEND, CONFIG_UART_BAUD) != 0) {
+        // Baud inalcançável no build: volta ao padrão de fábrica
+        uart_configure(UART_MINI, 115200);
+    }
+}
 
-    // Inicializa a Mini UART
-    *AUX_ENABLES = 1;      // Habilita a Mini UART (bit 0)
-    *AUX_MU_CNTL_REG = 0;  // Desabilita transmissor e receptor durante a configuração
-    *AUX_MU_IER_REG = 0;   // Desabilita interrupções
-    *AUX_MU_LCR_REG = 3;   // Define modo de 8 bits
-    *AUX_MU_MCR_REG = 0;   // Define RTS para nível alto
-    *AUX_MU_IIR_REG = 6;   // Limpa as filas (FIFOs)
+int uart_configure(int backend, uint32_t baud) {
+    if (backend != UART_MINI && backend != UART_PL011) return -1;
+    uart_flush();
+    const UartBackend* next = backends[backend];
+    if (next->init(baud) != 0) return -1;
+    uart = next;
+    current_backend = backend;
+    requested_baud = baud;
+    uart_ready = 1;
+    return 0;
+}
+
+int uart_set_core_clock(uint32_t hz) {
+    if (hz == 0) return -1;
+    mini_uart_set_clock(hz);
+    // A PL011 tem o seu próprio relógio (init_uart_clock) e não muda
+    if (current_backend != UART_MINI) return 0;
+    if (uart_configure(UART_MINI, requested_baud) == 0) return 0;
+    uart_configure(UART_MINI, 115200);
+    return -1;
+}
 
-    // Define o baud rate para 115200
-    // Baudrate = system_clock_freq / (8 * (baud_reg + 1))
-    // Com system_clock_freq = 250MHz (padrão), baud_reg = 270
-    *AUX_MU_BAUD_REG = 270;
+void uart_flush() {
+    if (!uart_ready) return;
+    while (!uart->tx_idle());
+}
 
-    // Habilita o transmissor e o receptor
-    *AUX_MU_CNTL_REG = 3;
+int uart_set_muted(int muted) {
+    int was_muted = uart_muted;
+    uart_muted = muted;
+    return was_muted;
 }
 
 void uart_putc(unsigned char c) {
-    // Espera até que o transmissor esteja pronto (bit 5 do LSR)
-    while (!(*AUX_MU_LSR_REG & 0x20));
-    *AUX_MU_IO_REG = c;
+    if (uart_muted) return;
+    // Espera até que a fila de transmissão tenha espaço
+    while (uart->tx_room() == 0);
+    uart->tx(c);
 }
 
 unsigned char uart_getc() {
-    // Espera até que haja dados para ler (bit 0 do LSR)
-    while (!(*AUX_MU_LSR_REG & 0x01));
-    return *AUX_MU_IO_REG & 0xFF;
+    // Espera até que haja dados para ler
+    while (!uart->rx_ready());
+    return uart->rx();
+}
+
+int uart_has_input() {
+    return uart->rx_ready();
 }
 
 void uart_puts(const char *s) {
-    while (*s) {
-        if (*s == '\n') {
-            uart_putc('\r');
+    uart_write(s, strlen(s));
+}
+
+// Escreve em rajadas: a cada consulta ao estado, preenche todo o espaço
+// livre da FIFO. Cada '\n' vira "\r\n".
+void uart_write(const char *s, uint32_t len) {
+    if (uart_muted) return;
+    uint32_t i = 0;
+    int cr_sent = 0;
+    while (i < len) {
+        uint32_t room = uart->tx_room();
+        for (; room > 0 && i < len; room--) {
+            if (s[i] == '\n' && !cr_sent) {
+                uart->tx('\r');
+                cr_sent = 1;
+            } else {
+                uart->tx(s[i++]);
+                cr_sent = 0;
+            }
         }
-        uart_putc(*s++);
     }
 }
 
+void uart_write_raw(const void* data, uint32_t len) {
+    if (uart_muted) return;
+    const unsigned char* p = data;
+    uint32_t i = 0;
+    while (i < len) {
+        uint32_t room = uart->tx_room();
+        for (; room > 0 && i < len; room--) uart->tx(p[i++]);
+    }
+}
+
+uint32_t uart_baud() {
+    return uart->actual_baud();
+}
+
+void uart_stat() {
+    uart_puts(" Controlador");
+    for (int i = strlen(" Controlador") + strlen(uart->name); i < LINE_WIDTH; i++) uart_puts(" ");
+    uart_puts(uart->name);
+    uart_puts("\n");
+    uart_puts_aligned(" Baud", uart_baud(), -1, NULL);
+    uart_puts_aligned(" FIFO de transmissao", uart->fifo_depth, -1, " Bytes");
+}
+
+void uart_puts_ratio(const char* text, uint32_t num, uint32_t den) {
+    // Duas casas decimais: num / den em centésimos
+    uint32_t ratio = den ? udiv32(num * 100, den) : 100;
+    char buf[16];
+    itoa(ratio / 100, buf);
+    uint32_t len = strlen(buf);
+    buf[len++] = '.';
+    buf[len++] = '0' + (ratio / 10) % 10;
+    buf[len++] = '0' + ratio % 10;
+    buf[len++] = 'x';
+    buf[len] = '\0';
+
+    uart_puts(text);
+    for (int i = strlen(text) + len; i < LINE_WIDTH; i++) uart_puts(" ");
+    uart_puts(buf);
+    uart_puts("\n");
+}
+
 void uart_puts_right_aligned(int num, int width) {
     char buf[16];
     itoa(num, buf);
@@ -99,13 +188,13 @@ void uart_puts_aligned(const char* text, int num1, int num2, const char* suffix)
 
     int text_len = strlen(text);
     int num1_len = strlen(buf1);
-    int num2_len = strlen(buf2);
+    int num2_len = num2 >= 0 ? strlen(buf2) + 3 : 0;
     int suffix_len = suffix ? strlen(suffix) : 0;
 
     // Espaços entre texto e números:
     // total = LINE_WIDTH - text_len - num1_len - (3 + num2_len + suffix_len)
-    // 3 = espaço + '/' + espaço
-    int spaces = LINE_WIDTH - text_len - num1_len - num2_len - suffix_len - 3;
+    // 3 = espaço + '/' + espaço, apenas quando num2 é exibido
+    int spaces = LINE_WIDTH - text_len - num1_len - num2_len - suffix_len;
 
     if (spaces < 1) spaces = 1;
 
@@ -0,0 +1,332 @@
+#include "bench.h"
+#include "sfs.h"
+#include "common.h"
+#include "uart.h"
+#include "timer.h"
+#include "fs_defs.h"
+#include "kmem.h"
+#include "flash.h"
+
+#define LOOKUP_ROUNDS 4
+#define LS_ROUNDS 16
+#define APPEND_CHUNK 256
+
+#define FLASH_BENCH_FILES 32
+#define FLASH_BENCH_CHURN 25
+#define FLASH_BENCH_SYNC_EVERY 8
+
+#if defined(__aarch64__)
+#define BENCH_ARCH "aarch64"
+#elif defined(__ARM_ARCH) && __ARM_ARCH >= 8
+#define BENCH_ARCH "armv8-a"
+#else
+#define BENCH_ARCH "armv7-a"
+#endif
+
+static void put_field(const char* key, uint32_t value) {
+    char buf[12];
+    itoa(value, buf);
+    uart_puts(" ");
+    uart_puts(key);
+    uart_puts("=");
+    uart_puts(buf);
+}
+
+// Uma linha por etapa: operações, tempo total e tempo por operação, mais
+// uma métrica própria opcional (ex.: vazão)
+static void report(const char* name, uint32_t ops, uint32_t us, const char* key, uint32_t value) {
+    // us * 1000 só cabe em 32 bits até ~4,2 s
+    uint32_t ns_op = us < 4000000 ? udiv32(us * 1000, ops) : udiv32(us, ops) * 1000;
+    int was_muted = uart_set_muted(0);
+    uart_puts("BENCH ");
+    uart_puts(name);
+    put_field("ops", ops);
+    put_field("us", us);
+    put_field("ns_op", ns_op);
+    if (key) put_field(key, value);
+    uart_puts("\n");
+    uart_set_muted(was_muted);
+}
+
+static void bench_error(const char* step) {
+    uart_puts("BENCH error step=");
+    uart_puts(step);
+    uart_puts("\n");
+}
+
+static void file_name(char* buf, char prefix, uint32_t i) {
+    buf[0] = prefix;
+    itoa(i, buf + 1);
+}
+
+// Bytes por milissegundo = KB/s (decimais)
+static uint32_t kb_per_s(uint32_t bytes, uint32_t us) {
+    return udiv32(bytes * 1000, us ? us : 1);
+}
+
+// Etapas dentro do diretório de rascunho; devolve o nome da que falhou
+static const char* run_suite(uint32_t files) {
+    char name[16];
+    uint32_t t;
+
+    t = timer_now_us();
+    for (uint32_t i = 0; i < files; i++) {
+        file_name(name, 'f', i);
+        if (fs_touch(name) != 0) return "touch";
+    }
+    report("touch", files, timer_now_us() - t, NULL, 0);
+
+    t = timer_now_us();
+    for (uint32_t r = 0; r < LOOKUP_ROUNDS; r++) {
+        for (uint32_t i = 0; i < files; i++) {
+            file_name(name, 'f', i);
+            if (find_entry(name) == -1) return "lookup_hit";
+        }
+    }
+    report("lookup_hit", files * LOOKUP_ROUNDS, timer_now_us() - t, NULL, 0);
+
+    t = timer_now_us();
+    for (uint32_t r = 0; r < LOOKUP_ROUNDS; r++) {
+        for (uint32_t i = 0; i < files; i++) {
+            file_name(name, 'x', i);
+            if (find_entry(name) != -1) return "lookup_miss";
+        }
+    }
+    report("lookup_miss", files * LOOKUP_ROUNDS, timer_now_us() - t, NULL, 0);
+
+    t = timer_now_us();
+    for (uint32_t r = 0; r < LS_ROUNDS; r++) fs_ls();
+    report("ls", LS_ROUNDS, timer_now_us() - t, "entries", files + 2);
+
+    // Anexa até o tamanho máximo de arquivo; cada pedaço tem um conteúdo
+    // diferente, para a deduplicação não mascarar as escritas
+    char chunk[APPEND_CHUNK + 1];
+    uint32_t appends = MAX_FILE_BLOCKS * BLOCK_SIZE / APPEND_CHUNK;
+    t = timer_now_us();
+    for (uint32_t i = 0; i < appends; i++) {
+        memset(chunk, 'a' + i % 26, APPEND_CHUNK);
+        itoa(i, chunk);
+        chunk[strlen(chunk)] = '-';
+        chunk[APPEND_CHUNK] = '\0';
+        if (fs_write("append.dat", chunk) != 0) return "append";
+    }
+    uint32_t us = timer_now_us() - t;
+    report("append", appends, us, "kBps", kb_per_s(appends * APPEND_CHUNK, us));
+
+    char block[BLOCK_SIZE];
+    uint32_t total = 0, reads = 0;
+    int n;
+    t = timer_now_us();
+    while ((n = fs_read("append.dat", total, block, BLOCK_SIZE)) > 0) {
+        total += n;
+        reads++;
+    }
+    us = timer_now_us() - t;
+    if (n < 0 || total != appends * APPEND_CHUNK) return "read";
+    report("read", reads, us, "kBps", kb_per_s(total, us));
+
+    t = timer_now_us();
+    for (uint32_t i = 0; i < files; i++) {
+        file_name(name, 'f', i);
+        if (fs_rm(name) != 0) return "rm";
+    }
+    report("rm", files, timer_now_us() - t, NULL, 0);
+    if (fs_rm("append.dat") != 0) return "rm";
+    return NULL;
+}
+
+// Cópia dos primeiros 'blocks' blocos do disco no heap, para as etapas que
+// o alteram por inteiro. O chamador guarda 'blocks' (o sb.total_blocks de
+// antes): fs_format pode aumentar o disco até fs_capacity.
+static uint8_t* snapshot_disk(uint32_t blocks) {
+    uint8_t* snapshot = kmem_alloc_pages((blocks * BLOCK_SIZE + PAGE_SIZE - 1) / PAGE_SIZE);
+    if (!snapshot) return NULL;
+    for (uint32_t b = 0; b < blocks; b++) {
+        read_block(b, &snapshot[b * BLOCK_SIZE]);
+    }
+    return snapshot;
+}
+
+// Regrava só os blocos que mudaram desde a cópia e remonta
+static void restore_disk(const uint8_t* snapshot, uint32_t blocks) {
+    for (uint32_t b = 0; b < blocks; b++) {
+        const void* now = get_block_unverified(b);
+        int same = memcmp(now, &snapshot[b * BLOCK_SIZE], BLOCK_SIZE) == 0;
+        put_block(b);
+        if (!same) write_block(b, &snapshot[b * BLOCK_SIZE]);
+    }
+    fs_mount();
+}
+
+// Formata e monta sobre o disco em uso: uma cópia fica no heap e é
+// restaurada em seguida, junto com o diretório atual
+static const char* bench_format() {
+    static FsContext saved_ctx;
+    uint32_t blocks = sb.total_blocks;
+    uint8_t* snapshot = snapshot_disk(blocks);
+    if (!snapshot) return "format_memory";
+    saved_ctx = *fs_ctx;
+
+    uint32_t t = timer_now_us();
+    fs_format();
+    uint32_t t_format = timer_now_us();
+    fs_mount();
+    uint32_t t_mount = timer_now_us();
+
+    restore_disk(snapshot, blocks);
+    kmem_free_pages(snapshot);
+    *fs_ctx = saved_ctx;
+
+    report("format", 1, t_format - t, NULL, 0);
+    report("mount", 1, t_mount - t_format, NULL, 0);
+    return NULL;
+}
+
+int fs_bench(uint32_t files) {
+    if (files == 0 || files > BENCH_MAX_FILES) {
+        uart_puts("Erro: Numero de arquivos invalido.\n");
+        return -1;
+    }
+    if (find_entry(BENCH_DIR) != -1) {
+        uart_puts("Erro: '" BENCH_DIR "' ja existe.\n");
+        return -1;
+    }
+
+    uart_puts("BENCH begin arch=" BENCH_ARCH " timer=systimer");
+    put_field("files", files);
+    uart_puts("\n");
+
+    // As mensagens das operações não entram na medida; report reativa a
+    // saída só para as linhas BENCH
+    uint32_t start = timer_now_us();
+    int was_muted = uart_set_muted(1);
+    const char* failed = "mkdir";
+    if (fs_mkdir(BENCH_DIR) == 0 && fs_cd(BENCH_DIR) == 0) {
+        failed = run_suite(files);
+        fs_cd("..");
+        fs_rm_recursive(BENCH_DIR);
+        if (!failed) failed = bench_format();
+    }
+    uart_set_muted(was_muted);
+
+    if (failed) {
+        bench_error(failed);
+        return -1;
+    }
+    uart_puts("BENCH end");
+    put_field("us", timer_now_us() - start);
+    uart_puts("\n");
+    return 0;
+}
+
+// Resultado de um layout: escritas do usuário, tempo de CPU e, do modelo do
+// dispositivo, blocos escritos, requisições, amplificação e vazão estimada
+static void report_flash(const char* name, uint32_t writes, uint32_t us, const FlashStats* stats) {
+    uint32_t dev_us = flash_model_us(stats);
+    int was_muted = uart_set_muted(0);
+    uart_puts("BENCH ");
+    uart_puts(name);
+    put_field("ops", writes);
+    put_field("us", us);
+    put_field("logical", stats->logical);
+    put_field("dev_writes", stats->device_writes);
+    put_field("requests", stats->requests);
+    put_field("wa_x100", udiv32(stats->device_writes * 100, stats->logical ? stats->logical : 1));
+    put_field("cleaned", stats->cleaned_segments);
+    put_field("dev_us", dev_us);
+    put_field("kBps", kb_per_s(writes * APPEND_CHUNK, dev_us));
+    uart_puts("\n");
+    uart_set_muted(was_muted);
+}
+
+// Anexações a FLASH_BENCH_FILES arquivos, com metade deles removida a cada
+// FLASH_BENCH_CHURN rodadas e uma sincronização a cada FLASH_BENCH_SYNC_EVERY
+// operações, como um cache de escrita que descarrega periodicamente
+static const char* run_flash_workload(const char* step, uint32_t rounds) {
+    char name[16], chunk[APPEND_CHUNK + 1];
+    uint32_t writes = 0, ops = 0;
+    if (fs_mkdir(BENCH_DIR) != 0 || fs_cd(BENCH_DIR) != 0) return "mkdir";
+
+    uint32_t t = timer_now_us();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (uint32_t i = 0; i < FLASH_BENCH_FILES; i++) {
+            file_name(name, 'f', i);
+            if (r % FLASH_BENCH_CHURN == FLASH_BENCH_CHURN - 1
+                && i % 2 == (r / FLASH_BENCH_CHURN) % 2) {
+                if (fs_rm(name) != 0) return "rm";
+            } else {
+                memset(chunk, 'a' + (r + i) % 26, APPEND_CHUNK);
+                itoa(r * FLASH_BENCH_FILES + i, chunk);
+                chunk[strlen(chunk)] = '-';
+                chunk[APPEND_CHUNK] = '\0';
+                if (fs_write(name, chunk) != 0) return "append";
+                writes++;
+            }
+            if (++ops % FLASH_BENCH_SYNC_EVERY == 0) flash_sync();
+        }
+    }
+    flash_sync();
+    uint32_t us = timer_now_us() - t;
+
+    FlashStats stats;
+    flash_get_stats(&stats);
+    report_flash(step, writes, us, &stats);
+    return NULL;
+}
+
+int fs_bench_flash(uint32_t rounds) {
+    static const int layouts[] = { FLASH_INPLACE, FLASH_LOG };
+    static const char* const steps[] = { "flash_inplace", "flash_log" };
+    static FsContext saved_ctx;
+
+    if (rounds == 0 || rounds > BENCH_FLASH_MAX_ROUNDS) {
+        uart_puts("Erro: Numero de rodadas invalido.\n");
+        return -1;
+    }
+    if (find_entry(BENCH_DIR) != -1) {
+        uart_puts("Erro: '" BENCH_DIR "' ja existe.\n");
+        return -1;
+    }
+    int saved_layout = flash_layout();
+    flash_set_layout(FLASH_OFF);
+    uint32_t blocks = sb.total_blocks;
+    uint8_t* snapshot = snapshot_disk(blocks);
+    if (!snapshot) {
+        uart_puts("Erro: Memoria insuficiente para a copia do disco.\n");
+        flash_set_layout(saved_layout);
+        return -1;
+    }
+    saved_ctx = *fs_ctx;
+
+    uart_puts("BENCH begin arch=" BENCH_ARCH " timer=systimer");
+    put_field("rounds", rounds);
+    put_field("files", FLASH_BENCH_FILES);
+    uart_puts("\n");
+
+    // Cada layout parte do mesmo disco, restaurado da cópia ao final
+    uint32_t start = timer_now_us();
+    int was_muted = uart_set_muted(1);
+    const char* failed = NULL;
+    for (uint32_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]) && !failed; i++) {
+        if (flash_set_layout(layouts[i]) != 0) {
+            failed = "flash_memory";
+            break;
+        }
+        failed = run_flash_workload(steps[i], rounds);
+        flash_set_layout(FLASH_OFF);
+        restore_disk(snapshot, blocks);
+        *fs_ctx = saved_ctx;
+    }
+    uart_set_muted(was_muted);
+    kmem_free_pages(snapshot);
+    flash_set_layout(saved_layout);
+
+    if (failed) {
+        bench_error(failed);
+        return -1;
+    }
+    uart_puts("BENCH end");
+    put_field("us", timer_now_us() - start);
+    uart_puts("\n");
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include "blksync.h"
+#include "sfs.h"
+#include "common.h"
+#include "uart.h"
+#include "fs_defs.h"
+#include "kmem.h"
+#include "crc32.h"
+#include "timer.h"
+
+// Marca de um mapa válido em .noinit ("DLOG")
+#define DIRTY_LOG_MAGIC 0x474F4C44
+
+#define CTRL_C 3
+
+// Blocos alterados desde o último checkpoint. Fica em .noinit, junto com o
+// disco em RAM: uma reinicialização a quente preserva os dois, e a próxima
+// exportação continua incremental.
+static struct {
+    uint32_t magic;
+    uint32_t checkpoint;
+    uint32_t dirty[DISK_BITMAP_WORDS];
+} dirty_log __attribute__((section(".noinit")));
+
+static int test_bit(const uint32_t* bitmap, uint32_t index) {
+    return (bitmap[index / 32] >> (index % 32)) & 1;
+}
+
+void blksync_mark(uint32_t block_num) {
+    set_bitmap_bit(dirty_log.dirty, block_num);
+}
+
+void blksync_mount() {
+    if (dirty_log.magic == DIRTY_LOG_MAGIC) return;
+
+    // Sem histórico confiável: o espelho precisa de uma imagem completa
+    memset(dirty_log.dirty, 0xFF, sizeof(dirty_log.dirty));
+    dirty_log.checkpoint = 0;
+    dirty_log.magic = DIRTY_LOG_MAGIC;
+}
+
+// Blocos livres não são exportados: nada no disco aponta para eles
+static int block_in_use(uint32_t block_num) {
+    return block_num < sb.data_area_start_block || test_bit(data_bitmap, block_num);
+}
+
+static uint32_t record_crc(uint32_t block_num, const void* data) {
+    return crc32(crc32(0, &block_num, sizeof(block_num)), data, BLOCK_SIZE);
+}
+
+static void put_word(uint32_t w) {
+    uart_putc(w & 0xFF);
+    uart_putc((w >> 8) & 0xFF);
+    uart_putc((w >> 16) & 0xFF);
+    uart_putc((w >> 24) & 0xFF);
+}
+
+// Fluxo interrompido: depois do primeiro silêncio longo, nada mais é lido
+static int timed_out;
+
+static uint8_t get_byte() {
+    if (timed_out) return 0;
+    uint32_t start = timer_now_us();
+    while (!uart_has_input()) {
+        if (timer_now_us() - start > BLKSYNC_TIMEOUT_US) {
+            timed_out = 1;
+            return 0;
+        }
+    }
+    return uart_getc();
+}
+
+static uint32_t get_word() {
+    uint32_t w = get_byte();
+    w |= (uint32_t)get_byte() << 8;
+    w |= (uint32_t)get_byte() << 16;
+    w |= (uint32_t)get_byte() << 24;
+    return w;
+}
+
+// Sem 'data', os bytes são só consumidos
+static void get_bytes(uint8_t* data, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t c = get_byte();
+        if (data) data[i] = c;
+    }
+}
+
+uint32_t blksync_export(int full) {
+    // O número de registros vai no cabeçalho: conta antes de enviar
+    uint32_t count = 0;
+    for (uint32_t b = 0; b < sb.total_blocks; b++) {
+        if ((full || test_bit(dirty_log.dirty, b)) && block_in_use(b)) count++;
+    }
+
+    uint32_t base = full ? 0 : dirty_log.checkpoint;
+    uint32_t next = dirty_log.checkpoint + 1;
+
+    put_word(BLKSYNC_MAGIC);
+    put_word(BLKSYNC_VERSION);
+    put_word(BLOCK_SIZE);
+    put_word(sb.total_blocks);
+    put_word(base);
+    put_word(next);
+    put_word(count);
+    for (uint32_t b = 0; b < sb.total_blocks; b++) {
+        if (!(full || test_bit(dirty_log.dirty, b)) || !block_in_use(b)) continue;
+        const uint8_t* data = get_block_unverified(b);
+        put_word(b);
+        uart_write_raw(data, BLOCK_SIZE);
+        put_word(record_crc(b, data));
+        put_block(b);
+    }
+    put_word(BLKSYNC_END);
+
+    memset(dirty_log.dirty, 0, sizeof(dirty_log.dirty));
+    dirty_log.checkpoint = next;
+    return count;
+}
+
+// Espera pelo magic do fluxo, descartando o que vier antes. Ctrl+C cancela.
+static int wait_for_stream() {
+    uint32_t window = 0;
+    while (window != BLKSYNC_MAGIC) {
+        unsigned char c = uart_getc();
+        if (c == CTRL_C) return -1;
+        window = (window >> 8) | ((uint32_t)c << 24);
+    }
+    return 0;
+}
+
+int blksync_import() {
+    uart_puts("Aguardando o fluxo de importacao (Ctrl+C cancela)...\n");
+    if (wait_for_stream() != 0) {
+        uart_puts("Importacao cancelada.\n");
+        return -1;
+    }
+
+    timed_out = 0;
+    uint32_t version = get_word();
+    uint32_t block_size = get_word();
+    uint32_t total = get_word();
+    uint32_t base = get_word();
+    uint32_t next = get_word();
+    uint32_t count = get_word();
+    if (timed_out) {
+        uart_puts("Erro: Fluxo interrompido.\n");
+        return -1;
+    }
+    if (version != BLKSYNC_VERSION || block_size != BLOCK_SIZE
+        || total > fs_capacity() || (base != 0 && total != sb.total_blocks) || count > total) {
+        uart_puts("Erro: Fluxo incompativel com este disco.\n");
+        return -1;
+    }
+
+    // Os registros são guardados em uma arena e só aplicados se todos
+    // conferirem. Sem memória ou com erro, o restante do fluxo ainda é
+    // consumido para não chegar ao shell como comandos. Um bloco zerado
+    // (para a imagem completa) também vem da arena, não da pilha.
+    Arena staging = ARENA_INIT;
+    uint32_t* blocks = arena_alloc(&staging, count * sizeof(uint32_t));
+    uint8_t* data = arena_alloc(&staging, count * BLOCK_SIZE);
+    const uint8_t* zero = arena_alloc(&staging, BLOCK_SIZE);
+    const char* error = (!blocks || !data || !zero) ? "Erro: Memoria insuficiente para a importacao.\n" : NULL;
+
+    for (uint32_t i = 0; i < count && !timed_out; i++) {
+        uint32_t block_num = get_word();
+        uint8_t* dst = error ? NULL : &data[i * BLOCK_SIZE];
+        get_bytes(dst, BLOCK_SIZE);
+        uint32_t crc = get_word();
+        if (error) continue;
+        if (block_num >= total || crc != record_crc(block_num, dst)) {
+            error = "Erro: Registro corrompido no fluxo.\n";
+            continue;
+        }
+        blocks[i] = block_num;
+    }
+    uint32_t end = get_word();
+    if (timed_out) error = "Erro: Fluxo interrompido.\n";
+    if (!error && end != BLKSYNC_END) error = "Erro: Fluxo sem o marcador final.\n";
+    if (!error && base != 0 && base != dirty_log.checkpoint) {
+        error = "Erro: O fluxo nao parte do checkpoint atual do disco.\n";
+    }
+    if (error) {
+        uart_puts(error);
+        arena_release(&staging);
+        return -1;
+    }
+
+    // Uma imagem completa substitui o disco inteiro; os blocos livres ficam zerados
+    if (base == 0) {
+        for (uint32_t b = 0; b < total; b++) write_block(b, zero);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        write_block(blocks[i], &data[i * BLOCK_SIZE]);
+    }
+    arena_release(&staging);
+
+    // O disco agora é igual ao espelho no checkpoint do fluxo
+    memset(dirty_log.dirty, 0, sizeof(dirty_log.dirty));
+    dirty_log.checkpoint = next;
+
+    fs_mount();
+    return count;
+}
+
+void blksync_stat() {
+    uint32_t dirty = 0;
+    for (uint32_t b = 0; b < sb.total_blocks; b++) {
+        if (test_bit(dirty_log.dirty, b) && block_in_use(b)) dirty++;
+    }
+    uart_puts_aligned(" Checkpoint atual", dirty_log.checkpoint, -1, NULL);
+    uart_puts_aligned(" Blocos alterados desde entao", dirty, -1, NULL);
+}
@@ -0,0 +1,93 @@
+#include "blktrace.h"
+
+#ifdef CONFIG_BLKTRACE
+
+#include "common.h"
+#include "uart.h"
+#include "timer.h"
+#include "perf.h"
+#include "fs_defs.h"
+
+uint32_t blktrace_current_op = PERF_OP_COUNT;
+
+static BlkTraceRecord trace_ring[BLKTRACE_ENTRIES];
+static uint32_t trace_head;     // Total de registros gravados desde o último clear
+static int trace_enabled = 1;
+
+void blktrace_record(uint32_t block_num, uint32_t rw) {
+    if (!trace_enabled) return;
+
+    BlkTraceRecord* r = &trace_ring[trace_head & (BLKTRACE_ENTRIES - 1)];
+    r->timestamp = timer_now_us();
+    r->info = (block_num & 0xFFFFFF) | ((blktrace_current_op & 0x7F) << 24) | (rw << 31);
+    trace_head++;
+}
+
+void blktrace_enable(int enabled) {
+    trace_enabled = enabled;
+}
+
+void blktrace_clear() {
+    trace_head = 0;
+}
+
+static uint32_t trace_count() {
+    return trace_head < BLKTRACE_ENTRIES ? trace_head : BLKTRACE_ENTRIES;
+}
+
+void blktrace_stat() {
+    uint32_t reads[PERF_OP_COUNT + 1] = {0};
+    uint32_t writes[PERF_OP_COUNT + 1] = {0};
+    uint32_t count = trace_count();
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t info = trace_ring[i].info;
+        uint32_t op = (info >> 24) & 0x7F;
+        if (op > PERF_OP_COUNT) op = PERF_OP_COUNT;
+        if (info >> 31) writes[op]++; else reads[op]++;
+    }
+
+    uart_puts("--- Rastreamento de E/S de blocos ---\n");
+    uart_puts_aligned(" Gravacao ativa", trace_enabled, -1, NULL);
+    uart_puts_aligned(" Acessos registrados", trace_head, -1, NULL);
+    uart_puts_aligned(" Acessos no buffer", count, BLKTRACE_ENTRIES, NULL);
+    uart_puts(" Leituras / escritas por operacao:\n");
+    for (uint32_t op = 0; op <= PERF_OP_COUNT; op++) {
+        if (reads[op] == 0 && writes[op] == 0) continue;
+        char label[24] = "  ";
+        strcat(label, op < PERF_OP_COUNT ? perf_op_name(op) : "(fora de operacao)");
+        uart_puts_aligned(label, reads[op], writes[op], NULL);
+    }
+    uart_puts("-------------------------------------------\n");
+}
+
+static void put_word(uint32_t w) {
+    uart_putc(w & 0xFF);
+    uart_putc((w >> 8) & 0xFF);
+    uart_putc((w >> 16) & 0xFF);
+    uart_putc((w >> 24) & 0xFF);
+}
+
+void blktrace_dump() {
+    uint32_t count = trace_count();
+    uint32_t first = trace_head - count;
+
+    // Pausa a gravação para o dump não registrar a si mesmo
+    int was_enabled = trace_enabled;
+    trace_enabled = 0;
+
+    put_word(BLKTRACE_MAGIC);
+    put_word(BLKTRACE_VERSION);
+    put_word(count);
+    put_word(sb.data_area_start_block);
+    put_word(sb.total_blocks);
+    for (uint32_t i = 0; i < count; i++) {
+        BlkTraceRecord* r = &trace_ring[(first + i) & (BLKTRACE_ENTRIES - 1)];
+        put_word(r->timestamp);
+        put_word(r->info);
+    }
+
+    trace_enabled = was_enabled;
+}
+
+#endif
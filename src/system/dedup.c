@@ -0,0 +1,205 @@
+#include "dedup.h"
+#include "common.h"
+#include "uart.h"
+#include "fs_defs.h"
+#include "kmem.h"
+#include "atomic.h"
+#include "crc32.h"
+
+#define INDEX_MASK (index_slots - 1)
+
+// Índice em memória: números de bloco (0 = posição livre) em uma tabela hash
+// indexada pelo fingerprint, com o dobro de posições dos blocos do disco
+// montado (em potência de 2). A chave não é guardada aqui: ela está na
+// tabela de checksums. Posições de blocos liberados viram lápides,
+// reaproveitadas na inserção e descartadas quando o índice é refeito.
+static uint32_t* dedup_index;
+static uint32_t index_slots;
+static uint32_t index_used;          // Posições ocupadas, incluindo lápides
+static Spinlock dedup_lock;
+
+// Blocos compartilhados em vez de gravados, desde a montagem
+static uint32_t dedup_hits;
+
+// O fingerprint é o próprio checksum do bloco (0 é reservado)
+static uint32_t fingerprint(const void* data) {
+    uint32_t crc = crc32(0, data, BLOCK_SIZE);
+    return crc ? crc : 1;
+}
+
+static int is_indexed(uint32_t block_num) {
+    return (refcount_table[block_num] & REF_INDEXED) != 0;
+}
+
+// Atualiza o checksum do bloco da tabela de referências que contém 'block_num'
+static void mark_ref_dirty(uint32_t block_num) {
+    mark_dirty_meta(sb.refcount_table_start_block + block_num / (BLOCK_SIZE / sizeof(uint32_t)));
+}
+
+static void index_insert(uint32_t block_num, uint32_t fp) {
+    uint32_t i = fp & INDEX_MASK;
+    while (dedup_index[i] != 0 && is_indexed(dedup_index[i])) {
+        i = (i + 1) & INDEX_MASK;
+    }
+    if (dedup_index[i] == 0) index_used++;
+    dedup_index[i] = block_num;
+}
+
+// Refaz o índice a partir da tabela de referências do disco
+static void rebuild_index() {
+    memset(dedup_index, 0, index_slots * sizeof(uint32_t));
+    index_used = 0;
+    for (uint32_t b = sb.data_area_start_block; b < sb.total_blocks; b++) {
+        if (is_indexed(b)) index_insert(b, csum_table[b]);
+    }
+}
+
+// Procura um bloco indexado com o mesmo conteúdo. O fingerprint só seleciona
+// candidatos; a igualdade é confirmada byte a byte.
+static uint32_t index_find(const void* data, uint32_t fp) {
+    for (uint32_t i = fp & INDEX_MASK; dedup_index[i] != 0; i = (i + 1) & INDEX_MASK) {
+        uint32_t b = dedup_index[i];
+        if (!is_indexed(b) || csum_table[b] != fp) continue;
+        if ((refcount_table[b] & REF_COUNT_MASK) == REF_COUNT_MASK) continue;  // Saturado
+
+        const void* block = get_block(b);
+        if (!block) continue;
+        int same = memcmp(block, data, BLOCK_SIZE) == 0;
+        put_block(b);
+        if (same) return b;
+    }
+    return 0;
+}
+
+// Menor potência de 2 com o dobro dos blocos do disco montado
+static uint32_t slots_for_disk() {
+    uint32_t slots = 1024;
+    while (slots < 2 * sb.total_blocks) slots *= 2;
+    return slots;
+}
+
+// Aloca o índice no tamanho do disco montado e o preenche
+static void index_alloc() {
+    index_slots = slots_for_disk();
+    dedup_index = kmalloc(index_slots * sizeof(uint32_t));
+    if (dedup_index) rebuild_index();
+}
+
+// Procura um bloco idêntico e, se houver, já reserva uma referência nele
+static uint32_t find_and_ref(const void* data, uint32_t fp) {
+    spin_lock(&dedup_lock);
+    uint32_t shared = dedup_index ? index_find(data, fp) : 0;
+    if (shared) {
+        refcount_table[shared]++;
+        mark_ref_dirty(shared);
+    }
+    spin_unlock(&dedup_lock);
+    return shared;
+}
+
+// Troca o bloco 'index' do arquivo pelo compartilhado; desfaz a referência
+// reservada se o ponteiro não puder ser gravado
+static int use_shared(uint32_t inode_num, uint32_t index, uint32_t shared) {
+    if (bmap_set(inode_num, index, shared) != 0) {
+        free_data_block(shared);
+        return 0;
+    }
+    atomic_fetch_add32(&dedup_hits, 1);
+    return 1;
+}
+
+void dedup_set_enabled(int enabled) {
+    spin_lock(&dedup_lock);
+    if (enabled && !dedup_index) {
+        index_alloc();
+    } else if (!enabled && dedup_index) {
+        kfree(dedup_index);
+        dedup_index = NULL;
+    }
+    spin_unlock(&dedup_lock);
+}
+
+int dedup_enabled() {
+    return dedup_index != NULL;
+}
+
+void dedup_mount() {
+    spin_lock(&dedup_lock);
+    if (dedup_index && index_slots != slots_for_disk()) {
+        // O disco mudou de tamanho
+        kfree(dedup_index);
+        index_alloc();
+        if (!dedup_index) uart_puts("AVISO: Sem memoria para o indice. Deduplicacao desligada.\n");
+    } else if (dedup_index) {
+        rebuild_index();
+    }
+    dedup_hits = 0;
+    spin_unlock(&dedup_lock);
+}
+
+int dedup_share(uint32_t inode_num, uint32_t index, const void* data, uint32_t* fp) {
+    *fp = 0;
+    if (!dedup_enabled()) return 0;
+
+    *fp = fingerprint(data);
+    uint32_t shared = find_and_ref(data, *fp);
+    return shared && use_shared(inode_num, index, shared);
+}
+
+void dedup_seal(uint32_t inode_num, uint32_t index, uint32_t block_num, uint32_t fp) {
+    if (!dedup_enabled()) return;
+
+    // Bloco completado aos poucos: ainda não foi comparado com os demais
+    if (fp == 0) {
+        const void* data = get_block(block_num);
+        fp = fingerprint(data);
+        uint32_t shared = find_and_ref(data, fp);
+        put_block(block_num);
+        if (shared && use_shared(inode_num, index, shared)) {
+            free_data_block(block_num);
+            return;
+        }
+    }
+
+    spin_lock(&dedup_lock);
+    if (dedup_index) {
+        if (index_used >= index_slots / 4 * 3) rebuild_index();
+        refcount_table[block_num] = REF_INDEXED;
+        mark_ref_dirty(block_num);
+        csum_set(block_num, fp);
+        index_insert(block_num, fp);
+    }
+    spin_unlock(&dedup_lock);
+}
+
+int dedup_unref(uint32_t block_num) {
+    // Um bloco fora do índice nunca é compartilhado
+    if (refcount_table[block_num] == 0) return 0;
+
+    spin_lock(&dedup_lock);
+    uint32_t ref = refcount_table[block_num];
+    int keep = (ref & REF_COUNT_MASK) != 0;
+    refcount_table[block_num] = keep ? ref - 1 : 0;
+    mark_ref_dirty(block_num);
+    spin_unlock(&dedup_lock);
+    return keep;
+}
+
+void dedup_stat(uint32_t used_blocks) {
+    uint32_t indexed = 0, saved = 0;
+    for (uint32_t b = sb.data_area_start_block; b < sb.total_blocks; b++) {
+        if (is_indexed(b)) {
+            indexed++;
+            saved += refcount_table[b] & REF_COUNT_MASK;
+        }
+    }
+
+    uart_puts_aligned(" Deduplicacao ligada", dedup_enabled(), -1, NULL);
+    uart_puts_aligned(" Blocos indexados", indexed, -1, NULL);
+    uart_puts_aligned(" Blocos economizados", saved, -1, NULL);
+    uart_puts_aligned(" Compartilhados nesta montagem", dedup_hits, -1, NULL);
+    // Razão entre o espaço que os arquivos ocupariam sem a deduplicação e o
+    // ocupado de fato
+    uart_puts_ratio(" Razao de dedup", used_blocks + saved, used_blocks);
+    uart_puts_aligned(" Memoria do indice", dedup_enabled() ? index_slots * sizeof(uint32_t) : 0, -1, " Bytes");
+}
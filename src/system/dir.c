@@ -2,94 +2,90 @@
 #include "common.h"
 #include "uart.h"
 #include "fs_defs.h"
+#include "perf.h"
+#include "kmem.h"
+#include "walk.h"
+#include "dedup.h"
+#include "blksync.h"
+#include "flash.h"
+#include "mailbox.h"
 
 int fs_mkdir(const char* dirname) {
-    if (strlen(dirname) >= MAX_FILENAME_LEN) return -1; // Nome muito longo
-    if (find_entry(dirname, NULL) != -1) return -2; // Já existe
+    PERF_SCOPE(PERF_FS_MKDIR);
+    if (fs_check_writable() != 0) return -1;
+    if (strlen(dirname) > MAX_FILENAME_LEN) return -1; // Nome muito longo
 
-    // Encontra inode e bloco de dados livres
-    int inode_idx = find_free_inode();
-    int data_block_idx = find_free_data_block();
-    if (inode_idx == -1 || data_block_idx == -1) return -3; // Sem espaço
+    uint32_t parent = fs_ctx->cwd_inode;
+    INODE_GUARD(parent);
+    if (dir_lookup(parent, dirname) != -1) return -2; // Já existe
 
-    // Adiciona a nova entrada no diretório atual
-    Inode current_dir_inode = inode_table[current_dir_inode_num];
-    DirectoryEntry dir_block[BLOCK_SIZE / sizeof(DirectoryEntry)];
-    int entry_added = 0;
-
-    for (int i = 0; i < MAX_DIRECT_POINTERS && !entry_added; i++) {
-        if (current_dir_inode.direct_pointers[i] != 0) {
-            read_block(current_dir_inode.direct_pointers[i], dir_block);
-            for (uint32_t j = 0; j < (BLOCK_SIZE / sizeof(DirectoryEntry)); j++) {
-                if (dir_block[j].filename[0] == '\0') {
-                    strcpy(dir_block[j].filename, dirname);
-                    dir_block[j].inode_number = inode_idx;
-                    write_block(current_dir_inode.direct_pointers[i], dir_block);
-                    entry_added = 1;
-                    break;
-                }
-            }
-        }
-    }
-
-    if (!entry_added) return -4; // Diretório pai cheio
+    // Reserva um inode livre
+    int inode_idx = alloc_inode();
+    if (inode_idx == -1) return -3; // Sem espaço
 
-    // Aloca e configura o novo inode e bloco de dados
-    set_bitmap_bit(inode_bitmap, inode_idx);
-    set_bitmap_bit(data_bitmap, data_block_idx);
-
-    Inode new_inode;
-    new_inode.type = 2; // Diretório
-    new_inode.size = 2 * sizeof(DirectoryEntry);
-    new_inode.direct_pointers[0] = data_block_idx;
-    for (int i = 1; i < MAX_DIRECT_POINTERS; i++) new_inode.direct_pointers[i] = 0;
-    inode_table[inode_idx] = new_inode;
+    // Configura o novo inode e seu primeiro bloco antes de torná-lo visível
+    Inode* new_inode = &inode_table[inode_idx];
+    memset(new_inode, 0, sizeof(Inode));
+    new_inode->type = ATTR_DIRECTORY;
+    if (dir_init_block(inode_idx, parent) != 0) {
+        free_inode(inode_idx);
+        return -3;
+    }
 
-    // Cria as entradas "." e ".." no novo diretório
-    DirectoryEntry new_dir_entries[BLOCK_SIZE / sizeof(DirectoryEntry)] = {0};
-    strcpy(new_dir_entries[0].filename, ".");
-    new_dir_entries[0].inode_number = inode_idx;
-    strcpy(new_dir_entries[1].filename, "..");
-    new_dir_entries[1].inode_number = current_dir_inode_num;
-    write_block(data_block_idx, new_dir_entries);
+    // Adiciona a nova entrada no diretório atual
+    if (dir_add_entry(parent, dirname, inode_idx, ATTR_DIRECTORY) != 0) { // Sem espaço no pai
+        inode_truncate(inode_idx);
+        free_inode(inode_idx);
+        return -4;
+    }
 
     return 0;
 }
 
 int fs_cd(const char* path) {
+    PERF_SCOPE(PERF_FS_CD);
     if (strcmp(path, "/") == 0) {
-        current_dir_inode_num = sb.root_inode_number;
-        strcpy(current_path_string, "/");
+        fs_ctx->cwd_inode = sb.root_inode_number;
+        strcpy(fs_ctx->cwd_path, "/");
         return 0;
     }
 
-    DirectoryEntry entry;
-    int inode_num = find_entry(path, &entry);
+    // A busca e a troca são feitas com o diretório atual travado: o destino
+    // é uma entrada dele (ou o seu pai, que não fica vazio enquanto ele
+    // existir) e um 'rm' de outra tarefa não consegue liberá-lo no meio
+    uint32_t cwd = fs_ctx->cwd_inode;
+    INODE_GUARD(cwd);
+    int inode_num = dir_lookup(cwd, path);
 
     if (inode_num != -1 && inode_table[inode_num].type == ATTR_DIRECTORY) {
-        current_dir_inode_num = inode_num;
+        // O caminho precisa caber em cwd_path com a nova "/" e o terminador
+        if (strlen(fs_ctx->cwd_path) + strlen(path) + 2 > MAX_PATH_LEN) {
+            uart_puts("Erro: Caminho muito longo.\n");
+            return -1;
+        }
+        fs_ctx->cwd_inode = inode_num;
 
         // Lógica para atualizar a string do caminho
         if (strcmp(path, "..") == 0) {
             // Se for '..', remove o último componente do caminho
-            uint32_t len = strlen(current_path_string);
+            uint32_t len = strlen(fs_ctx->cwd_path);
             if (len > 1) { // Não altera se já for "/"
                 for (int i = len - 2; i >= 0; i--) {
-                    if (current_path_string[i] == '/') {
-                        current_path_string[i+1] = '\0';
+                    if (fs_ctx->cwd_path[i] == '/') {
+                        fs_ctx->cwd_path[i+1] = '\0';
                         break;
                     }
                 }
             }
         } else {
             // Se for um diretório normal, adiciona ao caminho
-            if (strcmp(current_path_string, "/") != 0) {
-                strcat(current_path_string, path);
+            if (strcmp(fs_ctx->cwd_path, "/") != 0) {
+                strcat(fs_ctx->cwd_path, path);
             } else {
                 // Evita "//" no início
-                strcpy(current_path_string + 1, path);
+                strcpy(fs_ctx->cwd_path + 1, path);
             }
-            strcat(current_path_string, "/");
+            strcat(fs_ctx->cwd_path, "/");
         }
         return 0;
     }
@@ -100,30 +96,120 @@ int fs_cd(const char* path) {
     return -1;
 }
 
+// Imprime uma entrada de 'ls': o tipo e o nome
+static int print_entry(const DirectoryEntry* entry, void* arg) {
+    (void)arg;
+    uart_puts(entry->type == ATTR_DIRECTORY ? "d " : "- ");
+    uart_write(entry->name, entry->name_len);
+    uart_puts("\n");
+    return 0;
+}
+
 void fs_ls() {
-    Inode current_dir_inode = inode_table[current_dir_inode_num];
-    DirectoryEntry dir_block[BLOCK_SIZE / sizeof(DirectoryEntry)];
-
-    for (int i = 0; i < MAX_DIRECT_POINTERS; i++) {
-        if (current_dir_inode.direct_pointers[i] != 0) {
-            read_block(current_dir_inode.direct_pointers[i], dir_block);
-            for (uint32_t j = 0; j < (BLOCK_SIZE / sizeof(DirectoryEntry)); j++) {
-                if (dir_block[j].filename[0] != '\0') {
-                    Inode entry_inode = inode_table[dir_block[j].inode_number];
-                    if (entry_inode.type == 2) { // Diretório
-                        uart_puts("d ");
-                    } else { // Arquivo
-                        uart_puts("- ");
-                    }
-                    uart_puts(dir_block[j].filename);
-                    uart_puts("\n");
-                }
-            }
-        }
+    PERF_SCOPE(PERF_FS_LS);
+    INODE_GUARD(fs_ctx->cwd_inode);
+    // Um bloco corrompido já é relatado por get_block
+    dir_foreach(fs_ctx->cwd_inode, print_entry, NULL);
+}
+
+// Estado de 'du': o total parcial de cada diretório aberto, por profundidade
+typedef struct {
+    uint32_t* totals;
+    uint32_t files;
+    uint32_t dirs;
+} DuState;
+
+static void du_print(uint32_t bytes, const char* path) {
+    uart_puts_right_aligned(bytes, 10);
+    uart_puts("  ");
+    uart_puts(path);
+    uart_puts("\n");
+}
+
+static int du_visit(const WalkEntry* entry, int when, void* arg) {
+    DuState* du = arg;
+    uint32_t bytes = inode_blocks(entry->inode_num) * BLOCK_SIZE;
+
+    if (entry->type == ATTR_FILE) {
+        du->totals[entry->depth - 1] += bytes;
+        du->files++;
+    } else if (when == WALK_PRE) {
+        du->totals[entry->depth] = bytes;
+        du->dirs++;
+    } else {
+        du_print(du->totals[entry->depth], entry->path);
+        du->totals[entry->depth - 1] += du->totals[entry->depth];
+    }
+    return 0;
+}
+
+int fs_du(const char* name) {
+    int target = lock_entry(name);
+    if (target == -1) {
+        uart_puts("Erro: Arquivo ou diretorio nao encontrado.\n");
+        return -1;
+    }
+    INODE_GUARD_HELD(target);
+    if (!name) name = ".";
+
+    // Um arquivo: só o seu próprio espaço
+    if (inode_table[target].type != ATTR_DIRECTORY) {
+        du_print(inode_blocks(target) * BLOCK_SIZE, name);
+        return 0;
+    }
+
+    Arena scratch = ARENA_INIT;
+    DuState du = { arena_alloc(&scratch, (NUM_INODES + 1) * sizeof(uint32_t)), 0, 0 };
+    if (!du.totals) {
+        uart_puts("Erro: Memoria insuficiente.\n");
+        arena_release(&scratch);
+        return -1;
     }
+
+    du.totals[0] = inode_blocks(target) * BLOCK_SIZE;
+    int result = fs_walk(target, name, du_visit, &du);
+
+    if (result == 0) {
+        du_print(du.totals[0], name);
+        uart_puts_aligned(" Arquivos", du.files, -1, NULL);
+        uart_puts_aligned(" Diretorios", du.dirs, -1, NULL);
+    } else {
+        uart_puts("Erro: Diretorio corrompido. Use 'fsck -r'.\n");
+    }
+    arena_release(&scratch);
+    return result;
+}
+
+// Estado de 'find': o nome procurado e quantas entradas o têm
+typedef struct {
+    const char* name;
+    uint32_t matches;
+} FindState;
+
+static int find_visit(const WalkEntry* entry, int when, void* arg) {
+    FindState* find = arg;
+    if (when == WALK_PRE && strcmp(entry->name, find->name) == 0) {
+        uart_puts(entry->path);
+        uart_puts(entry->type == ATTR_DIRECTORY ? "/\n" : "\n");
+        find->matches++;
+    }
+    return 0;
+}
+
+int fs_find(const char* name) {
+    uint32_t cwd = fs_ctx->cwd_inode;
+    INODE_GUARD(cwd);
+    FindState find = { name, 0 };
+    if (fs_walk(cwd, ".", find_visit, &find) != 0) {
+        uart_puts("Erro: Diretorio corrompido. Use 'fsck -r'.\n");
+        return -1;
+    }
+    if (find.matches == 0) uart_puts("Nenhuma entrada encontrada.\n");
+    return find.matches;
 }
 
 void fs_stat() {
+  PERF_SCOPE(PERF_FS_STAT);
   uint32_t used_inodes = 0;
   for (int i = 0; i < NUM_INODES; i++) {
       if ((inode_bitmap[i / 32] >> (i % 32)) & 1) {
@@ -132,7 +218,7 @@ void fs_stat() {
   }
 
   uint32_t used_data_blocks = 0;
-  for (int i = 0; i < NUM_DATA_BLOCKS; i++) {
+  for (uint32_t i = 0; i < sb.total_blocks; i++) {
       if ((data_bitmap[i / 32] >> (i % 32)) & 1) {
           used_data_blocks++;
       }
@@ -140,7 +226,7 @@ void fs_stat() {
 
   uint32_t metadata_blocks = sb.data_area_start_block;
   uint32_t user_blocks_used = used_data_blocks - metadata_blocks;
-  uint32_t total_user_blocks = NUM_DATA_BLOCKS - metadata_blocks;
+  uint32_t total_user_blocks = sb.total_blocks - metadata_blocks;
 
 char buf[32], buf2[32];
 
@@ -180,5 +266,14 @@ for (int i = 0; i < len_spaces; i++) uart_puts(" ");
 uart_puts(buf);
 uart_puts(" Bytes\n");
 
+// O volume montado e a capacidade reservada no boot, que vale no próximo 'format'
+uart_puts_aligned(" Disco / capacidade", sb.total_blocks * BLOCK_SIZE / 1024,
+                  fs_capacity() * BLOCK_SIZE / 1024, " KB");
+mbox_stat();
+uart_puts_aligned(" Erros de checksum", csum_errors, -1, NULL);
+dedup_stat(user_blocks_used);
+blksync_stat();
+flash_stat();
+
 uart_puts("-------------------------------------------\n");
 }
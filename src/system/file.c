@@ -2,69 +2,87 @@
 #include "common.h"
 #include "uart.h"
 #include "fs_defs.h"
+#include "perf.h"
+#include "walk.h"
+#include "dedup.h"
+#include "task.h"
+
+// Envia até 'len' bytes de texto pela UART, parando em um '\0'
+static void put_text(const char* text, uint32_t len) {
+    uint32_t n = 0;
+    while (n < len && text[n]) n++;
+    uart_write(text, n);
+}
 
-int fs_touch(const char* filename) {
-    if (strlen(filename) >= MAX_FILENAME_LEN) {
-        uart_puts("Erro: Nome do arquivo muito longo.\n");
-        return -1;
-    }
-    if (find_entry(filename, NULL) != -1) {
+// Cria um arquivo vazio em 'parent', que o chamador já travou
+static int create_file(uint32_t parent, const char* filename) {
+    if (dir_lookup(parent, filename) != -1) {
         uart_puts("Erro: Arquivo ou diretorio ja existe.\n");
         return -2;
     }
 
-    // 1. Encontrar um inode livre para o novo arquivo.
-    int inode_idx = find_free_inode();
+    // 1. Reservar um inode livre para o novo arquivo.
+    int inode_idx = alloc_inode();
     if (inode_idx == -1) {
         uart_puts("Erro: Sem inodes livres no disco.\n");
         return -3;
     }
 
-    // 2. Encontrar um slot vazio no diretório atual.
-    Inode current_dir_inode = inode_table[current_dir_inode_num];
-    DirectoryEntry dir_block[BLOCK_SIZE / sizeof(DirectoryEntry)];
-    int entry_added = 0;
-
-    for (int i = 0; i < MAX_DIRECT_POINTERS && !entry_added; i++) {
-        if (current_dir_inode.direct_pointers[i] != 0) {
-            read_block(current_dir_inode.direct_pointers[i], dir_block);
-            for (uint32_t j = 0; j < (BLOCK_SIZE / sizeof(DirectoryEntry)); j++) {
-                if (dir_block[j].filename[0] == '\0') {
-                    // Slot vazio encontrado!
-                    strcpy(dir_block[j].filename, filename);
-                    dir_block[j].inode_number = inode_idx;
-                    write_block(current_dir_inode.direct_pointers[i], dir_block);
-                    entry_added = 1;
-                    break;
-                }
-            }
-        }
-    }
+    // 2. Configurar o novo inode antes de torná-lo visível.
+    // Tamanho zero e nenhum bloco de dados alocado.
+    Inode* new_inode = &inode_table[inode_idx];
+    memset(new_inode, 0, sizeof(Inode));
+    new_inode->type = ATTR_FILE;
+    mark_inode_dirty(inode_idx);
 
-    if (!entry_added) {
+    // 3. Gravar a entrada em um espaço livre do diretório atual.
+    if (dir_add_entry(parent, filename, inode_idx, ATTR_FILE) != 0) {
+        free_inode(inode_idx);
         uart_puts("Erro: Diretorio atual esta cheio.\n");
         return -4;
     }
 
-    // 3. Alocar e configurar o novo inode.
-    set_bitmap_bit(inode_bitmap, inode_idx);
-
-    Inode new_inode;
-    new_inode.type = 1; // Tipo Arquivo
-    new_inode.size = 0; // Tamanho inicial zero
-    for (int i = 0; i < MAX_DIRECT_POINTERS; i++) {
-        new_inode.direct_pointers[i] = 0; // Nenhum bloco de dados alocado
-    }
-    inode_table[inode_idx] = new_inode;
-
     uart_puts("Arquivo '");
     uart_puts(filename);
     uart_puts("' criado.\n");
     return 0;
 }
 
+int fs_touch(const char* filename) {
+    PERF_SCOPE(PERF_FS_TOUCH);
+    if (fs_check_writable() != 0) return -1;
+    if (strlen(filename) > MAX_FILENAME_LEN) {
+        uart_puts("Erro: Nome do arquivo muito longo.\n");
+        return -1;
+    }
+    uint32_t parent = fs_ctx->cwd_inode;
+    INODE_GUARD(parent);
+    return create_file(parent, filename);
+}
+
+// Procura um arquivo no diretório atual (com 'create', cria se faltar) e o
+// devolve travado. O diretório fica travado da busca até o arquivo ser
+// travado, como em rm_entry: um 'rm' de outra tarefa não consegue liberar o
+// inode (nem ele ser reaproveitado) entre os dois passos.
+// Retorna o inode, -1 se o arquivo não existir (ou não puder ser criado) ou
+// -2 se o nome for de um diretório.
+static int lock_file(const char* filename, int create) {
+    uint32_t parent = fs_ctx->cwd_inode;
+    INODE_GUARD(parent);
+    int inode_num = dir_lookup(parent, filename);
+    if (inode_num == -1 && create && create_file(parent, filename) == 0) {
+        inode_num = dir_lookup(parent, filename);
+    }
+    if (inode_num == -1) return -1;
+    if (inode_table[inode_num].type != ATTR_FILE) return -2;
+    inode_lock(inode_num);
+    return inode_num;
+}
+
 int fs_write(const char* filename, const char* text) {
-    if (strlen(filename) >= MAX_FILENAME_LEN) {
+    PERF_SCOPE(PERF_FS_WRITE);
+    if (fs_check_writable() != 0) return -1;
+    if (strlen(filename) > MAX_FILENAME_LEN) {
         uart_puts("Erro: Nome do arquivo muito longo.\n");
         return -1;
     }
@@ -72,77 +90,70 @@ int fs_write(const char* filename, const char* text) {
         return 0; // Nada a escrever
     }
 
-    int inode_num = find_entry(filename, NULL);
-
     // Se o arquivo não existe, cria ele primeiro
+    int inode_num = lock_file(filename, 1);
     if (inode_num == -1) {
-        if (fs_touch(filename) != 0) {
-            uart_puts("Erro: Nao foi possivel criar o arquivo.\n");
-            return -1;
-        }
-        inode_num = find_entry(filename, NULL);
+        uart_puts("Erro: Nao foi possivel criar o arquivo.\n");
+        return -1;
     }
-
-    Inode file_inode = inode_table[inode_num];
-    if (file_inode.type != 1) {
+    if (inode_num == -2) {
         uart_puts("Erro: Nao e um arquivo.\n");
         return -1;
     }
 
-    uint32_t text_len = strlen(text);
-    const char* text_ptr = text;
-    uint32_t bytes_to_write = text_len;
+    INODE_GUARD_HELD(inode_num);
+    Inode* file_inode = &inode_table[inode_num];
 
-    // Posição inicial para escrita (final do arquivo)
-    uint32_t offset_in_block = file_inode.size % BLOCK_SIZE;
-    uint32_t current_block_ptr_idx = file_inode.size / BLOCK_SIZE;
+    const char* text_ptr = text;
+    uint32_t bytes_to_write = strlen(text);
 
-    // Se houver um bloco parcialmente preenchido, completa ele primeiro
-    if (offset_in_block > 0) {
-        char buffer[BLOCK_SIZE];
-        uint32_t block_to_write_num = file_inode.direct_pointers[current_block_ptr_idx-1];
-        read_block(block_to_write_num, buffer);
+    // Anexa ao final do arquivo: completa o último bloco no lugar e aloca
+    // os seguintes (diretos e, depois, via bloco indireto)
+    while (bytes_to_write > 0) {
+        uint32_t index = file_inode->size / BLOCK_SIZE;
+        uint32_t offset_in_block = file_inode->size % BLOCK_SIZE;
+        if (index >= MAX_FILE_BLOCKS) {
+            uart_puts("Erro: Arquivo atingiu o tamanho maximo.\n");
+            break;
+        }
 
         uint32_t space_in_block = BLOCK_SIZE - offset_in_block;
         uint32_t write_now_len = (bytes_to_write < space_in_block) ? bytes_to_write : space_in_block;
 
-        memcpy(buffer + offset_in_block, text_ptr, write_now_len);
-        write_block(block_to_write_num, buffer);
-
-        text_ptr += write_now_len;
-        bytes_to_write -= write_now_len;
-        file_inode.size += write_now_len;
-    }
-
-    // Aloca novos blocos para o restante do texto
-    while (bytes_to_write > 0) {
-        current_block_ptr_idx = file_inode.size / BLOCK_SIZE;
-        if (current_block_ptr_idx >= MAX_DIRECT_POINTERS) {
-            uart_puts("Erro: Arquivo atingiu o tamanho maximo.\n");
-            break;
+        // Bloco inteiro com conteúdo já presente no disco: só referencia
+        uint32_t fp = 0;
+        if (write_now_len == BLOCK_SIZE && dedup_share(inode_num, index, text_ptr, &fp)) {
+            text_ptr += BLOCK_SIZE;
+            bytes_to_write -= BLOCK_SIZE;
+            file_inode->size += BLOCK_SIZE;
+            continue;
         }
 
-        int new_block_idx = find_free_data_block();
-        if (new_block_idx == -1) {
+        uint32_t block_num = bmap(inode_num, index, offset_in_block == 0);
+        if (block_num == 0) {
             uart_puts("Erro: Disco cheio.\n");
             break;
         }
 
-        set_bitmap_bit(data_bitmap, new_block_idx);
-        file_inode.direct_pointers[current_block_ptr_idx] = new_block_idx;
+        char* block = get_block(block_num);
+        memcpy(block + offset_in_block, text_ptr, write_now_len);
+        if (offset_in_block == 0) {
+            memset(block + write_now_len, 0, BLOCK_SIZE - write_now_len);
+        }
+        mark_dirty(block_num);
+        put_block(block_num);
 
-        char buffer[BLOCK_SIZE] = {0};
-        uint32_t write_now_len = (bytes_to_write < BLOCK_SIZE) ? bytes_to_write : BLOCK_SIZE;
-        memcpy(buffer, text_ptr, write_now_len);
-        write_block(new_block_idx, buffer);
+        // Bloco completo não muda mais (a escrita só anexa): entra no índice
+        if (offset_in_block + write_now_len == BLOCK_SIZE) {
+            dedup_seal(inode_num, index, block_num, fp);
+        }
 
         text_ptr += write_now_len;
         bytes_to_write -= write_now_len;
-        file_inode.size += write_now_len;
+        file_inode->size += write_now_len;
+        task_yield();
     }
-
-    // Salva o inode atualizado
-    inode_table[inode_num] = file_inode;
+    mark_inode_dirty(inode_num);
 
     uart_puts("Texto anexado ao arquivo '");
     uart_puts(filename);
@@ -152,116 +163,194 @@ int fs_write(const char* filename, const char* text) {
 }
 
 int fs_cat(const char* filename) {
-    DirectoryEntry entry;
-    int inode_num = find_entry(filename, &entry);
-
-    if (inode_num == -1 || inode_table[inode_num].type != 1) {
+    PERF_SCOPE(PERF_FS_CAT);
+    int inode_num = lock_file(filename, 0);
+    if (inode_num < 0) {
         uart_puts("Arquivo nao encontrado.\n");
         return -1;
     }
 
-    Inode file_inode = inode_table[inode_num];
-    char buffer[BLOCK_SIZE + 1];
-    buffer[BLOCK_SIZE] = '\0';
-    uint32_t bytes_to_read = file_inode.size;
-
-    for (int i = 0; i < MAX_DIRECT_POINTERS && bytes_to_read > 0; i++) {
-        if (file_inode.direct_pointers[i] != 0) {
-            read_block(file_inode.direct_pointers[i], buffer);
-            if (bytes_to_read < BLOCK_SIZE) {
-                buffer[bytes_to_read] = '\0';
+    INODE_GUARD_HELD(inode_num);
+    Inode* file_inode = &inode_table[inode_num];
+    uint32_t bytes_to_read = file_inode->size;
+
+    for (uint32_t i = 0; i < MAX_FILE_BLOCKS && bytes_to_read > 0; i++) {
+        uint32_t block = bmap(inode_num, i, 0);
+        if (block != 0) {
+            uint32_t len = (bytes_to_read < BLOCK_SIZE ? bytes_to_read : BLOCK_SIZE);
+            const char* data = get_block(block);
+            if (!data) {
+                uart_puts("\n");
+                return -1;
             }
-            uart_puts(buffer);
-            bytes_to_read -= (bytes_to_read < BLOCK_SIZE ? bytes_to_read : BLOCK_SIZE);
+            put_text(data, len);
+            put_block(block);
+            bytes_to_read -= len;
+            task_yield();
         }
     }
     uart_puts("\n");
     return 0;
 }
 
-int fs_rm(const char* filename) {
+int fs_read(const char* filename, uint32_t offset, void* buffer, uint32_t len) {
+    PERF_SCOPE(PERF_FS_READ);
+    int inode_num = lock_file(filename, 0);
+    if (inode_num < 0) return -1;
+
+    INODE_GUARD_HELD(inode_num);
+    Inode* file_inode = &inode_table[inode_num];
+    if (offset >= file_inode->size) return 0;
+    if (len > file_inode->size - offset) len = file_inode->size - offset;
+
+    char* out = buffer;
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t pos = offset + done;
+        uint32_t offset_in_block = pos % BLOCK_SIZE;
+        uint32_t chunk = BLOCK_SIZE - offset_in_block;
+        if (chunk > len - done) chunk = len - done;
+
+        uint32_t block_num = bmap(inode_num, pos / BLOCK_SIZE, 0);
+        if (block_num == 0) {
+            memset(out + done, 0, chunk);   // Buraco: lê como zeros
+        } else {
+            const char* block = get_block(block_num);
+            if (!block) return -1;
+            memcpy(out + done, block + offset_in_block, chunk);
+            put_block(block_num);
+        }
+        done += chunk;
+        task_yield();
+    }
+    return done;
+}
+
+// Interrompe dir_foreach na primeira entrada que não seja "." ou ".."
+static int reject_entry(const DirectoryEntry* entry, void* arg) {
+    (void)arg;
+    int is_dot = entry->name[0] == '.'
+        && (entry->name_len == 1 || (entry->name_len == 2 && entry->name[1] == '.'));
+    return !is_dot;
+}
+
+// Libera os blocos e o inode de um item já desligado da árvore
+static void release_inode(uint32_t inode_num) {
+    inode_truncate(inode_num);
+    free_inode(inode_num);
+}
+
+// Apaga o conteúdo de um diretório: cada arquivo ao ser encontrado e cada
+// subdiretório depois do seu conteúdo, ainda travado pelo percurso. As
+// entradas não são removidas uma a uma: os blocos do diretório são
+// liberados inteiros junto com ele.
+static int rm_visit(const WalkEntry* entry, int when, void* arg) {
+    uint32_t* removed = arg;
+    if (entry->type == ATTR_DIRECTORY) {
+        if (when == WALK_PRE) return 0;
+        release_inode(entry->inode_num);
+    } else {
+        INODE_GUARD(entry->inode_num);
+        release_inode(entry->inode_num);
+    }
+    (*removed)++;
+    return 0;
+}
+
+// Interrompe o percurso no primeiro diretório que é o atual de alguma
+// tarefa. A conferência é feita em WALK_POST, com o diretório ainda travado
+// pelo percurso: quem estiver nele não consegue sair (um 'cd' trava o
+// diretório atual) para um subdiretório já conferido.
+static int busy_visit(const WalkEntry* entry, int when, void* arg) {
+    if (entry->type != ATTR_DIRECTORY || when != WALK_POST) return 0;
+    if (!task_uses_dir(entry->inode_num)) return 0;
+    *(int*)arg = 1;
+    return -1;
+}
+
+static int rm_entry(const char* filename, int recursive) {
+    PERF_SCOPE(PERF_FS_RM);
+    if (fs_check_writable() != 0) return -1;
     // Proibir a exclusão de "." e ".."
     if (strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0) {
         uart_puts("Erro: Nao e possivel deletar '.' ou '..'.\n");
         return -1;
     }
 
-    uint32_t entry_block_num; // Bloco onde a entrada de diretório está
-    uint32_t entry_index;     // Índice da entrada dentro do bloco
-
     // 1. Encontrar a entrada de diretório para obter o número do inode
-    DirectoryEntry entry;
-    int inode_num = -1;
-    int found = 0;
-    Inode dir_inode = inode_table[current_dir_inode_num];
-    DirectoryEntry dir_block_buffer[BLOCK_SIZE / sizeof(DirectoryEntry)];
-
-    for (int i = 0; i < MAX_DIRECT_POINTERS && !found; i++) {
-        if (dir_inode.direct_pointers[i] != 0) {
-            read_block(dir_inode.direct_pointers[i], dir_block_buffer);
-            for (uint32_t j = 0; j < (BLOCK_SIZE / sizeof(DirectoryEntry)); j++) {
-                if (dir_block_buffer[j].filename[0] != '\0' && strcmp(dir_block_buffer[j].filename, filename) == 0) {
-                    entry = dir_block_buffer[j];
-                    inode_num = entry.inode_number;
-                    entry_block_num = dir_inode.direct_pointers[i];
-                    entry_index = j;
-                    found = 1;
-                    break;
-                }
-            }
-        }
-    }
-
-    if (!found) {
+    uint32_t parent = fs_ctx->cwd_inode;
+    INODE_GUARD(parent);
+    int found = dir_lookup(parent, filename);
+    if (found == -1) {
         uart_puts("Erro: Arquivo ou diretorio nao encontrado.\n");
         return -1;
     }
 
-    // 2. Ler o inode do item a ser deletado
-    Inode target_inode = inode_table[inode_num];
-
-    // 3. Lógica de deleção baseada no tipo (arquivo ou diretório)
-    if (target_inode.type == ATTR_DIRECTORY) {
-        // Lógica para deletar um diretório
-        int entry_count = 0;
-        DirectoryEntry content_buffer[BLOCK_SIZE / sizeof(DirectoryEntry)];
-        for (int i = 0; i < MAX_DIRECT_POINTERS; i++) {
-            if (target_inode.direct_pointers[i] != 0) {
-                read_block(target_inode.direct_pointers[i], content_buffer);
-                for (uint32_t j = 0; j < (BLOCK_SIZE / sizeof(DirectoryEntry)); j++) {
-                    if (content_buffer[j].filename[0] != '\0') {
-                        entry_count++;
-                    }
-                }
-            }
+    // 2. Ler o inode do item a ser deletado (pai já travado, depois o filho)
+    uint32_t inode_num = found;
+    INODE_GUARD(inode_num);
+    Inode* target_inode = &inode_table[inode_num];
+
+    // 3. Um diretório que é o atual de alguma tarefa (ele ou, com -r, um
+    // dos seus subdiretórios) não pode ser liberado
+    if (target_inode->type == ATTR_DIRECTORY) {
+        int busy = task_uses_dir(inode_num);
+        if (!busy && recursive && fs_walk(inode_num, filename, busy_visit, &busy) != 0 && !busy) {
+            uart_puts("Erro: Diretorio corrompido. Use 'fsck -r'.\n");
+            return -4;
         }
-
-        // Um diretório vazio tem exatamente 2 entradas: "." e ".."
-        if (entry_count > 2) {
-            uart_puts("Erro: O diretorio nao esta vazio.\n");
-            return -3;
+        if (busy) {
+            uart_puts("Erro: Diretorio em uso por uma tarefa.\n");
+            return -5;
         }
     }
 
-    // 4. Se for um arquivo ou um diretório vazio, a lógica de liberação é a mesma:
-    // Liberar os blocos de dados no bitmap de dados
-    for (int i = 0; i < MAX_DIRECT_POINTERS; i++) {
-        if (target_inode.direct_pointers[i] != 0) {
-            clear_bitmap_bit(data_bitmap, target_inode.direct_pointers[i]);
+    // 4. Com -r, o conteúdo do diretório é apagado antes dele. Sem -r, um
+    // diretório só pode ser deletado se tiver apenas "." e ".."
+    uint32_t removed = 0;
+    if (target_inode->type == ATTR_DIRECTORY && recursive) {
+        if (fs_walk(inode_num, filename, rm_visit, &removed) != 0) {
+            uart_puts("Erro: Diretorio corrompido. Use 'fsck -r'.\n");
+            return -4;
+        }
+    } else if (target_inode->type == ATTR_DIRECTORY) {
+        int result = dir_foreach(inode_num, reject_entry, NULL);
+        if (result < 0) {
+            uart_puts("Erro: Diretorio corrompido.\n");
+            return -4;
+        }
+        if (result > 0) {
+            uart_puts("Erro: O diretorio nao esta vazio.\n");
+            return -3;
         }
     }
 
-    // Liberar o inode no bitmap de inodes
-    clear_bitmap_bit(inode_bitmap, inode_num);
+    // 5. A partir daqui, arquivo e diretório (vazio) são liberados do mesmo
+    // jeito: os blocos de dados e o inode
+    release_inode(inode_num);
 
-    // 5. Apagar a entrada no diretório pai
-    read_block(entry_block_num, dir_block_buffer);
-    dir_block_buffer[entry_index].filename[0] = '\0'; // Marca como vazia
-    write_block(entry_block_num, dir_block_buffer);
+    // 6. Apagar a entrada no diretório pai, juntando seu espaço ao da anterior
+    dir_remove_entry(parent, filename);
 
     uart_puts("Item '");
     uart_puts(filename);
-    uart_puts("' deletado.\n");
+    uart_puts("' deletado");
+    if (removed > 0) {
+        char buf[12];
+        itoa(removed, buf);
+        uart_puts(" com ");
+        uart_puts(buf);
+        uart_puts(" itens");
+    }
+    uart_puts(".\n");
 
     return 0;
 }
+
+int fs_rm(const char* filename) {
+    return rm_entry(filename, 0);
+}
+
+int fs_rm_recursive(const char* filename) {
+    return rm_entry(filename, 1);
+}
@@ -0,0 +1,462 @@
+#include "flash.h"
+#include "sfs.h"
+#include "common.h"
+#include "uart.h"
+#include "fs_defs.h"
+#include "kmem.h"
+#include "crc32.h"
+
+#define SEGMENT_DATA    (FLASH_SEGMENT_BLOCKS - 1)   // Blocos de dados por resumo, no máximo
+
+#define SUMMARY_MAGIC    0x4D4D5553   // "SUMM"
+#define CHECKPOINT_MAGIC 0x54504B43   // "CKPT"
+
+#define NO_BLOCK 0xFFFFFFF0
+
+// Resumo no início de cada grupo de blocos anexado ao log. 'next_segment'
+// é o segmento que vem depois deste, para a recuperação seguir o log.
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t count;
+    uint32_t next_segment;
+    uint32_t crc;
+    uint32_t blocks[SEGMENT_DATA];
+} SegmentSummary;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;              // Número do checkpoint; vale o maior válido
+    uint32_t log_seq;          // Sequência do próximo resumo
+    uint32_t head_segment;
+    uint32_t head_offset;
+    uint32_t next_segment;
+    uint32_t crc;              // Do mapa seguido deste cabeçalho (com crc = 0)
+} CheckpointHeader;
+
+enum { SEG_FREE, SEG_USED, SEG_CHECKPOINT };
+
+static int layout = FLASH_OFF;
+static uint8_t* device;
+static uint32_t last_written = NO_BLOCK;
+static FlashStats stats;
+static uint32_t dirty[DISK_BITMAP_WORDS];
+
+// Geometria do layout log, calculada para o disco montado ao trocar de
+// layout. Os primeiros segmentos guardam dois checkpoints alternados, de
+// 'slot_segments' cada: o mapa e, no fim, o cabeçalho que o valida (escrito
+// por último).
+static uint32_t layout_blocks;               // sb.total_blocks na troca de layout
+static uint32_t segments;                    // Total, com os checkpoints
+static uint32_t checkpoint_segments;         // 2 * slot_segments
+static uint32_t slot_segments;
+static uint32_t map_blocks;
+
+// Estado do layout log. Um segmento usado que fica sem blocos vivos só
+// volta a ser livre depois de um checkpoint: até lá, a recuperação ainda
+// pode precisar percorrer seus resumos. O mapa fica no heap, com o
+// dispositivo, em blocos inteiros (map_blocks) para o checkpoint.
+static uint32_t* map;                        // Lógico -> físico (0 = sem cópia)
+static uint16_t seg_live[FLASH_MAX_SEGMENTS];
+static uint8_t seg_state[FLASH_MAX_SEGMENTS];
+static uint32_t free_segments;
+static uint32_t head_segment, head_offset, next_segment;
+static uint32_t log_seq, checkpoint_seq, segments_since_checkpoint;
+static uint32_t cleaned_pending;             // Esvaziados, à espera do checkpoint
+
+static int test_bit(const uint32_t* bitmap, uint32_t index) {
+    return (bitmap[index / 32] >> (index % 32)) & 1;
+}
+
+static int block_in_use(uint32_t block_num) {
+    return block_num < sb.data_area_start_block || test_bit(data_bitmap, block_num);
+}
+
+static uint32_t device_blocks() {
+    return layout == FLASH_LOG ? segments * FLASH_SEGMENT_BLOCKS : sb.total_blocks;
+}
+
+// Uma escrita que não continua a anterior abre uma nova requisição
+static void dev_write(uint32_t phys, const void* data) {
+    memcpy(&device[phys * BLOCK_SIZE], data, BLOCK_SIZE);
+    stats.device_writes++;
+    if (phys != last_written + 1) stats.requests++;
+    last_written = phys;
+}
+
+static const uint8_t* dev_read(uint32_t phys) {
+    stats.device_reads++;
+    last_written = NO_BLOCK;
+    return &device[phys * BLOCK_SIZE];
+}
+
+void flash_mark(uint32_t block_num) {
+    if (layout != FLASH_OFF) set_bitmap_bit(dirty, block_num);
+}
+
+int flash_layout() {
+    return layout;
+}
+
+// --- Layout log ---
+
+static uint32_t take_free_segment() {
+    for (uint32_t s = checkpoint_segments; s < segments; s++) {
+        if (seg_state[s] == SEG_FREE) {
+            seg_state[s] = SEG_USED;
+            free_segments--;
+            return s;
+        }
+    }
+    return NO_BLOCK;
+}
+
+static void unmap(uint32_t block_num) {
+    uint32_t old = map[block_num];
+    if (old) seg_live[old / FLASH_SEGMENT_BLOCKS]--;
+    map[block_num] = 0;
+}
+
+static void checkpoint() {
+    uint32_t base = (checkpoint_seq + 1) % 2 * slot_segments * FLASH_SEGMENT_BLOCKS;
+    uint8_t block[BLOCK_SIZE];
+    memset(block, 0, BLOCK_SIZE);
+    CheckpointHeader* h = (CheckpointHeader*)block;
+    h->magic = CHECKPOINT_MAGIC;
+    h->seq = ++checkpoint_seq;
+    h->log_seq = log_seq;
+    h->head_segment = head_segment;
+    h->head_offset = head_offset;
+    h->next_segment = next_segment;
+    h->crc = crc32(crc32(0, map, map_blocks * BLOCK_SIZE), h, sizeof(*h));
+
+    for (uint32_t i = 0; i < map_blocks; i++) {
+        dev_write(base + i, (const uint8_t*)map + i * BLOCK_SIZE);
+    }
+    dev_write(base + map_blocks, block);
+    stats.checkpoint_blocks += map_blocks + 1;
+    segments_since_checkpoint = 0;
+
+    // O checkpoint não depende mais dos segmentos sem blocos vivos
+    for (uint32_t s = checkpoint_segments; s < segments; s++) {
+        if (seg_state[s] == SEG_USED && seg_live[s] == 0
+            && s != head_segment && s != next_segment) {
+            seg_state[s] = SEG_FREE;
+            free_segments++;
+        }
+    }
+    cleaned_pending = 0;
+}
+
+static void advance_head() {
+    head_segment = next_segment;
+    head_offset = 0;
+    next_segment = take_free_segment();
+    if (next_segment == NO_BLOCK) {
+        // Os segmentos esvaziados desde o último checkpoint são a reserva
+        checkpoint();
+        next_segment = take_free_segment();
+    }
+    if (++segments_since_checkpoint >= FLASH_CHECKPOINT_EVERY * slot_segments) checkpoint();
+}
+
+// Anexa 'count' blocos ao log em grupos de um resumo seguido dos dados
+static void log_append(const uint32_t* blocks, const uint8_t* const* data, uint32_t count) {
+    while (count > 0) {
+        if (head_offset + 1 >= FLASH_SEGMENT_BLOCKS) advance_head();
+        uint32_t n = FLASH_SEGMENT_BLOCKS - head_offset - 1;
+        if (n > count) n = count;
+
+        uint8_t block[BLOCK_SIZE];
+        memset(block, 0, BLOCK_SIZE);
+        SegmentSummary* s = (SegmentSummary*)block;
+        s->magic = SUMMARY_MAGIC;
+        s->seq = log_seq++;
+        s->count = n;
+        s->next_segment = next_segment;
+        memcpy(s->blocks, blocks, n * sizeof(uint32_t));
+        s->crc = crc32(0, s, sizeof(*s));
+
+        uint32_t phys = head_segment * FLASH_SEGMENT_BLOCKS + head_offset;
+        dev_write(phys, block);
+        stats.summaries++;
+        for (uint32_t i = 0; i < n; i++) {
+            dev_write(phys + 1 + i, data[i]);
+            unmap(blocks[i]);
+            map[blocks[i]] = phys + 1 + i;
+            seg_live[head_segment]++;
+        }
+        head_offset += n + 1;
+        blocks += n;
+        data += n;
+        count -= n;
+    }
+}
+
+// Segmento usado com menos blocos vivos (limpeza gulosa)
+static uint32_t pick_victim() {
+    uint32_t victim = NO_BLOCK, best = SEGMENT_DATA;
+    for (uint32_t s = checkpoint_segments; s < segments; s++) {
+        if (seg_state[s] != SEG_USED || seg_live[s] == 0) continue;
+        if (s == head_segment || s == next_segment) continue;
+        if (seg_live[s] < best) {
+            best = seg_live[s];
+            victim = s;
+        }
+    }
+    return victim;
+}
+
+// Copia os blocos vivos da vítima para o fim do log, seguindo seus resumos
+static void clean_segment(uint32_t victim) {
+    uint32_t blocks[SEGMENT_DATA];
+    const uint8_t* data[SEGMENT_DATA];
+    uint32_t base = victim * FLASH_SEGMENT_BLOCKS;
+    uint32_t live = 0;
+
+    for (uint32_t off = 0; off + 1 < FLASH_SEGMENT_BLOCKS && seg_live[victim] > live; ) {
+        const SegmentSummary* s = (const SegmentSummary*)dev_read(base + off);
+        if (s->magic != SUMMARY_MAGIC || s->count == 0 || s->count > FLASH_SEGMENT_BLOCKS - off - 1) break;
+        for (uint32_t i = 0; i < s->count; i++) {
+            uint32_t phys = base + off + 1 + i;
+            if (s->blocks[i] >= layout_blocks || map[s->blocks[i]] != phys) continue;
+            blocks[live] = s->blocks[i];
+            data[live++] = dev_read(phys);
+        }
+        off += s->count + 1;
+    }
+    log_append(blocks, data, live);
+    stats.relocated += live;
+    stats.cleaned_segments++;
+    cleaned_pending++;
+}
+
+// Um segmento por chamada; o checkpoint libera os esvaziados ao atingir o alvo
+static int clean_step(uint32_t target) {
+    if (free_segments + cleaned_pending >= target || free_segments <= 1) {
+        if (cleaned_pending) checkpoint();
+        return 0;
+    }
+    uint32_t victim = pick_victim();
+    if (victim == NO_BLOCK) {
+        if (cleaned_pending) checkpoint();
+        return 0;
+    }
+    clean_segment(victim);
+    return 1;
+}
+
+uint32_t flash_clean(uint32_t target) {
+    if (layout != FLASH_LOG) return 0;
+    uint32_t cleaned = 0;
+    while (clean_step(target)) cleaned++;
+    if (cleaned_pending) checkpoint();
+    return cleaned;
+}
+
+void flash_idle() {
+    if (layout == FLASH_LOG && (free_segments < FLASH_CLEAN_HIGH || cleaned_pending)) {
+        clean_step(FLASH_CLEAN_HIGH);
+    }
+}
+
+static void log_sync_batch(const uint32_t* blocks, uint32_t count) {
+    const uint8_t* data[SEGMENT_DATA] = {0};   // Só as 'count' primeiras são usadas
+    for (uint32_t i = 0; i < count; i++) data[i] = get_block_unverified(blocks[i]);
+    if (free_segments < FLASH_CLEAN_LOW) flash_clean(FLASH_CLEAN_HIGH);
+    log_append(blocks, data, count);
+    for (uint32_t i = 0; i < count; i++) put_block(blocks[i]);
+}
+
+uint32_t flash_sync() {
+    if (layout == FLASH_OFF) return 0;
+    uint32_t batch[SEGMENT_DATA];
+    uint32_t count = 0, synced = 0;
+
+    for (uint32_t b = 0; b < sb.total_blocks; b++) {
+        if (!block_in_use(b)) {
+            // O bitmap de dados faz as vezes de TRIM: a cópia de um bloco
+            // liberado deixa de contar como viva
+            if (layout == FLASH_LOG && map[b]) unmap(b);
+            continue;
+        }
+        if (!test_bit(dirty, b)) continue;
+        if (layout == FLASH_INPLACE) {
+            dev_write(b, get_block_unverified(b));
+            put_block(b);
+        } else {
+            batch[count++] = b;
+            if (count == SEGMENT_DATA) {
+                log_sync_batch(batch, count);
+                count = 0;
+            }
+        }
+        synced++;
+    }
+    if (count) log_sync_batch(batch, count);
+
+    memset(dirty, 0, sizeof(dirty));
+    stats.logical += synced;
+    return synced;
+}
+
+// Lê o checkpoint mais recente com CRC válido
+static const CheckpointHeader* latest_checkpoint() {
+    const CheckpointHeader* best = NULL;
+    for (uint32_t s = 0; s < 2; s++) {
+        const uint8_t* base = &device[s * slot_segments * FLASH_SEGMENT_BLOCKS * BLOCK_SIZE];
+        CheckpointHeader h = *(const CheckpointHeader*)&base[map_blocks * BLOCK_SIZE];
+        uint32_t crc = h.crc;
+        h.crc = 0;
+        if (h.magic != CHECKPOINT_MAGIC
+            || crc32(crc32(0, base, map_blocks * BLOCK_SIZE), &h, sizeof(h)) != crc) continue;
+        const CheckpointHeader* valid = (const CheckpointHeader*)&base[map_blocks * BLOCK_SIZE];
+        if (!best || valid->seq > best->seq) best = valid;
+    }
+    return best;
+}
+
+int flash_verify() {
+    if (layout != FLASH_LOG) return -1;
+    const CheckpointHeader* h = latest_checkpoint();
+    if (!h) return -1;
+
+    Arena scratch = ARENA_INIT;
+    uint32_t* recovered = arena_alloc(&scratch, map_blocks * BLOCK_SIZE);
+    if (!recovered) return -1;
+    memcpy(recovered, (const uint8_t*)h - map_blocks * BLOCK_SIZE, map_blocks * BLOCK_SIZE);
+
+    // Avança pelos resumos escritos depois do checkpoint, na ordem do log
+    uint32_t seq = h->log_seq, seg = h->head_segment, off = h->head_offset;
+    uint32_t next = h->next_segment, replayed = 0;
+    while (1) {
+        if (off + 1 >= FLASH_SEGMENT_BLOCKS) {
+            if (next >= segments) break;
+            seg = next;
+            off = 0;
+        }
+        SegmentSummary s = *(const SegmentSummary*)&device[(seg * FLASH_SEGMENT_BLOCKS + off) * BLOCK_SIZE];
+        uint32_t crc = s.crc;
+        s.crc = 0;
+        if (s.magic != SUMMARY_MAGIC || s.seq != seq || s.count == 0
+            || s.count > FLASH_SEGMENT_BLOCKS - off - 1 || crc32(0, &s, sizeof(s)) != crc) break;
+        for (uint32_t i = 0; i < s.count; i++) {
+            if (s.blocks[i] < sb.total_blocks) recovered[s.blocks[i]] = seg * FLASH_SEGMENT_BLOCKS + off + 1 + i;
+        }
+        next = s.next_segment;
+        off += s.count + 1;
+        seq++;
+        replayed++;
+    }
+
+    int bad = 0;
+    for (uint32_t b = 0; b < sb.total_blocks; b++) {
+        if (!block_in_use(b)) continue;
+        const void* now = get_block_unverified(b);
+        if (!recovered[b] || memcmp(&device[recovered[b] * BLOCK_SIZE], now, BLOCK_SIZE) != 0) bad++;
+        put_block(b);
+    }
+    arena_release(&scratch);
+
+    uart_puts_aligned(" Checkpoint usado", h->seq, -1, NULL);
+    uart_puts_aligned(" Resumos reaplicados", replayed, -1, NULL);
+    return bad;
+}
+
+// --- Troca de layout ---
+
+int flash_set_layout(int new_layout) {
+    if (device) {
+        kmem_free_pages(device);
+        kmem_free_pages(map);
+        device = NULL;
+        map = NULL;
+    }
+    layout = FLASH_OFF;
+    if (new_layout == FLASH_OFF) return 0;
+
+    // O log tem 25% a mais que o disco, fora os checkpoints
+    layout_blocks = sb.total_blocks;
+    map_blocks = (sb.total_blocks * sizeof(uint32_t) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    slot_segments = (map_blocks + 1 + FLASH_SEGMENT_BLOCKS - 1) / FLASH_SEGMENT_BLOCKS;
+    checkpoint_segments = 2 * slot_segments;
+    segments = (sb.total_blocks + sb.total_blocks / 4) / FLASH_SEGMENT_BLOCKS + checkpoint_segments;
+    if (segments > FLASH_MAX_SEGMENTS) segments = FLASH_MAX_SEGMENTS;
+
+    uint32_t blocks = new_layout == FLASH_LOG ? segments * FLASH_SEGMENT_BLOCKS : sb.total_blocks;
+    device = kmem_alloc_pages((blocks * BLOCK_SIZE + PAGE_SIZE - 1) / PAGE_SIZE);
+    map = kmem_alloc_pages((map_blocks * BLOCK_SIZE + PAGE_SIZE - 1) / PAGE_SIZE);
+    if (!device || !map) {
+        kmem_free_pages(device);
+        kmem_free_pages(map);
+        device = NULL;
+        map = NULL;
+        return -1;
+    }
+    memset(device, 0, blocks * BLOCK_SIZE);   // Um dispositivo recém-apagado
+    layout = new_layout;
+
+    memset(map, 0, map_blocks * BLOCK_SIZE);
+    memset(seg_live, 0, sizeof(seg_live));
+    memset(seg_state, SEG_FREE, sizeof(seg_state));
+    for (uint32_t s = 0; s < checkpoint_segments; s++) seg_state[s] = SEG_CHECKPOINT;
+    free_segments = segments - checkpoint_segments;
+    cleaned_pending = 0;
+    segments_since_checkpoint = 0;
+    checkpoint_seq = 0;
+    log_seq = 1;
+    if (layout == FLASH_LOG) {
+        head_segment = take_free_segment();
+        next_segment = take_free_segment();
+        head_offset = 0;
+    }
+
+    // Cópia inicial de todos os blocos em uso
+    memset(dirty, 0xFF, sizeof(dirty));
+    flash_sync();
+    if (layout == FLASH_LOG) checkpoint();
+    memset(&stats, 0, sizeof(stats));
+    last_written = NO_BLOCK;
+    return 0;
+}
+
+void flash_resize() {
+    if (layout == FLASH_OFF || sb.total_blocks == layout_blocks) return;
+    if (flash_set_layout(layout) != 0) {
+        uart_puts("AVISO: Sem memoria para o dispositivo flash. Layout desligado.\n");
+    }
+}
+
+void flash_get_stats(FlashStats* out) {
+    *out = stats;
+}
+
+uint32_t flash_model_us(const FlashStats* s) {
+    return s->requests * FLASH_REQUEST_US + (s->device_writes + s->device_reads) * FLASH_BLOCK_US;
+}
+
+void flash_stat() {
+    static const char* const names[] = { "desligado", "inplace", "log" };
+    const char* name = names[layout];
+    uart_puts(" Layout do dispositivo");
+    for (int i = strlen(" Layout do dispositivo") + strlen(name); i < LINE_WIDTH; i++) uart_puts(" ");
+    uart_puts(name);
+    uart_puts("\n");
+    if (layout == FLASH_OFF) return;
+
+    uart_puts_aligned(" Blocos logicos gravados", stats.logical, -1, NULL);
+    uart_puts_aligned(" Blocos escritos no dispositivo", stats.device_writes, -1, NULL);
+    uart_puts_aligned(" Requisicoes de escrita", stats.requests, -1, NULL);
+    uart_puts_ratio(" Amplificacao de escrita", stats.device_writes, stats.logical);
+    uart_puts_ratio(" Blocos por requisicao", stats.device_writes, stats.requests);
+    uart_puts_aligned(" Tempo estimado do dispositivo", flash_model_us(&stats) / 1000, -1, " ms");
+    uart_puts_aligned(" Capacidade do dispositivo", device_blocks(), -1, " Blocos");
+    if (layout != FLASH_LOG) return;
+
+    uart_puts_aligned(" Segmentos livres", free_segments, segments - checkpoint_segments, NULL);
+    uart_puts_aligned(" Resumos de segmento", stats.summaries, -1, NULL);
+    uart_puts_aligned(" Blocos de checkpoint", stats.checkpoint_blocks, -1, NULL);
+    uart_puts_aligned(" Segmentos limpos", stats.cleaned_segments, -1, NULL);
+    uart_puts_aligned(" Blocos relocados", stats.relocated, -1, NULL);
+    uart_puts_aligned(" Blocos lidos pelo limpador", stats.device_reads, -1, NULL);
+}
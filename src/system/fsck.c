@@ -0,0 +1,443 @@
+#include "sfs.h"
+#include "common.h"
+#include "uart.h"
+#include "timer.h"
+#include "task.h"
+#include "fs_defs.h"
+#include "perf.h"
+#include "kmem.h"
+#include "dedup.h"
+
+#define INODE_BITMAP_WORDS ((NUM_INODES + 31) / 32)
+#define DATA_BITMAP_WORDS ((sb.total_blocks + 31) / 32)
+
+// Bitmaps "sombra", reconstruídos a partir da árvore de diretórios, fila de
+// diretórios a visitar, o pai de cada diretório (para validar "..") e as
+// reivindicações de cada bloco além da primeira (blocos deduplicados).
+// Vivem em uma arena de rascunho liberada ao fim de cada verificação.
+static uint32_t* shadow_inode_bitmap;
+static uint32_t* shadow_data_bitmap;
+static uint32_t* dir_queue;
+static uint32_t* parent_of;
+static uint32_t* extra_claims;
+
+// Contadores de problemas encontrados
+static struct {
+    uint32_t bad_superblock;
+    uint32_t bad_pointers;
+    uint32_t double_allocated;
+    uint32_t dangling_entries;
+    uint32_t bad_records;
+    uint32_t bad_dot_entries;
+    uint32_t bad_sizes;
+    uint32_t orphan_inodes;
+    uint32_t leaked_blocks;
+    uint32_t unmarked_blocks;
+    uint32_t bad_checksums;
+    uint32_t bad_refcounts;
+} fsck_stats;
+
+static int test_bit(const uint32_t* bitmap, uint32_t index) {
+    return (bitmap[index / 32] >> (index % 32)) & 1;
+}
+
+static uint32_t count_bits(uint32_t word) {
+    uint32_t n = 0;
+    while (word) {
+        word &= word - 1;
+        n++;
+    }
+    return n;
+}
+
+// Registra o bloco 'block' como pertencente a um inode. Retorna 0 se o
+// ponteiro for válido e ainda não tiver sido reivindicado por outro inode,
+// ou se for um bloco deduplicado com referências sobrando.
+static int claim_block(uint32_t block) {
+    if (block < sb.data_area_start_block || block >= sb.total_blocks) {
+        fsck_stats.bad_pointers++;
+        return -1;
+    }
+    if (test_bit(shadow_data_bitmap, block)) {
+        if (extra_claims[block] < (refcount_table[block] & REF_COUNT_MASK)) {
+            extra_claims[block]++;
+            return 0;
+        }
+        fsck_stats.double_allocated++;
+        return -1;
+    }
+    set_bitmap_bit(shadow_data_bitmap, block);
+    return 0;
+}
+
+// Valida o ponteiro para o bloco 'index' do inode. 'used' é o número de
+// blocos que o tamanho do inode cobre e 'valid', o prefixo de blocos já
+// verificados e reivindicados. Retorna 1 se o ponteiro foi corrigido.
+static int check_pointer(Inode* inode, uint32_t* pointer, uint32_t index,
+                         uint32_t* used, uint32_t* valid, int repair) {
+    uint32_t block = *pointer;
+
+    // Um buraco dentro do tamanho faria fs_write anexar ao bloco 0
+    if (block == 0) {
+        if (index < *used) {
+            fsck_stats.bad_sizes++;
+            *used = index;
+            if (*valid > index) *valid = index;
+            if (repair) inode->size = index * BLOCK_SIZE;
+        }
+        return 0;
+    }
+
+    // Ponteiros além do tamanho também são vazamentos
+    if (index >= *used) {
+        fsck_stats.bad_pointers++;
+        if (repair) *pointer = 0;
+        return repair;
+    }
+
+    // Ponteiro inválido ou já reivindicado: trunca o inode neste ponto
+    if (claim_block(block) != 0) {
+        if (*valid > index) *valid = index;
+        if (repair) {
+            *pointer = 0;
+            inode->size = index * BLOCK_SIZE;
+            *used = index;
+        }
+        return repair;
+    }
+    return 0;
+}
+
+// Valida os ponteiros diretos e indiretos e o tamanho de um inode, arquivo
+// ou diretório. Retorna quantos blocos iniciais são válidos e pertencem só a ele.
+static uint32_t check_blocks(uint32_t inode_num, int repair) {
+    Inode* inode = &inode_table[inode_num];
+    uint32_t used = (inode->size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    if (used > MAX_FILE_BLOCKS) {
+        fsck_stats.bad_sizes++;
+        used = MAX_FILE_BLOCKS;
+        if (repair) inode->size = MAX_FILE_BLOCKS * BLOCK_SIZE;
+    }
+    uint32_t valid = used;
+
+    for (uint32_t i = 0; i < MAX_DIRECT_POINTERS; i++) {
+        check_pointer(inode, &inode->direct_pointers[i], i, &used, &valid, repair);
+    }
+
+    uint32_t indirect = inode->indirect_pointer;
+    if (indirect == 0) {
+        if (used > MAX_DIRECT_POINTERS) {
+            fsck_stats.bad_sizes++;
+            used = valid = MAX_DIRECT_POINTERS;
+            if (repair) inode->size = MAX_DIRECT_POINTERS * BLOCK_SIZE;
+        }
+        return valid;
+    }
+
+    // Bloco indireto sem uso ou inválido: seus blocos ficam para a
+    // reconciliação dos bitmaps
+    if (used <= MAX_DIRECT_POINTERS || claim_block(indirect) != 0) {
+        if (used <= MAX_DIRECT_POINTERS) fsck_stats.bad_pointers++;
+        if (valid > MAX_DIRECT_POINTERS) valid = MAX_DIRECT_POINTERS;
+        if (repair) {
+            inode->indirect_pointer = 0;
+            if (used > MAX_DIRECT_POINTERS) inode->size = MAX_DIRECT_POINTERS * BLOCK_SIZE;
+        }
+        return valid;
+    }
+
+    int modified = 0;
+    if (!block_csum_ok(indirect)) {
+        fsck_stats.bad_checksums++;
+        modified = repair;
+    }
+    uint32_t* pointers = get_block_unverified(indirect);
+    for (uint32_t i = 0; i < POINTERS_PER_BLOCK; i++) {
+        modified |= check_pointer(inode, &pointers[i], MAX_DIRECT_POINTERS + i,
+                                  &used, &valid, repair);
+    }
+    if (modified) mark_dirty_meta(indirect);
+    put_block(indirect);
+    return valid;
+}
+
+// Ponteiro para o bloco 'index' já validado por check_blocks
+static uint32_t block_at(const Inode* inode, uint32_t index) {
+    if (index < MAX_DIRECT_POINTERS) return inode->direct_pointers[index];
+    const uint32_t* pointers = get_block_unverified(inode->indirect_pointer);
+    uint32_t block = pointers[index - MAX_DIRECT_POINTERS];
+    put_block(inode->indirect_pointer);
+    return block;
+}
+
+// Remove a entrada 'e' de um bloco de diretório, como dir_remove_entry
+static void drop_entry(DirectoryEntry* prev, DirectoryEntry* e) {
+    if (prev) {
+        prev->rec_len += e->rec_len;
+    } else {
+        e->name_len = 0;
+        e->inode_number = 0;
+    }
+}
+
+// Percorre as entradas de um bloco de diretório, validando "." e ".." e
+// enfileirando os subdiretórios. Retorna 1 se o bloco foi corrigido.
+static int check_dir_block(uint32_t dir_num, char* data, uint32_t* queue_tail, int repair) {
+    int modified = 0;
+    DirectoryEntry* prev = NULL;
+    DirectoryEntry* e;
+
+    for (uint32_t off = 0; off < BLOCK_SIZE; off += e->rec_len) {
+        e = (DirectoryEntry*)(data + off);
+
+        // Registro malformado: o restante do bloco é descartado
+        if (!dirent_valid(e, off)) {
+            fsck_stats.bad_records++;
+            if (repair) {
+                if (prev) {
+                    prev->rec_len = BLOCK_SIZE - ((char*)prev - data);
+                } else {
+                    e->rec_len = BLOCK_SIZE;
+                    e->name_len = 0;
+                    e->inode_number = 0;
+                }
+                modified = 1;
+            }
+            break;
+        }
+
+        // Só a primeira entrada do bloco pode ficar vazia
+        if (e->name_len == 0) {
+            if (prev) {
+                fsck_stats.bad_records++;
+                if (repair) {
+                    drop_entry(prev, e);
+                    modified = 1;
+                    continue;
+                }
+            }
+            prev = e;
+            continue;
+        }
+
+        int is_dot = e->name[0] == '.'
+            && (e->name_len == 1 || (e->name_len == 2 && e->name[1] == '.'));
+        if (is_dot) {
+            uint32_t expected = e->name_len == 2 ? parent_of[dir_num] : dir_num;
+            if (e->inode_number != expected || e->type != ATTR_DIRECTORY) {
+                fsck_stats.bad_dot_entries++;
+                if (repair) {
+                    e->inode_number = expected;
+                    e->type = ATTR_DIRECTORY;
+                    modified = 1;
+                }
+            }
+            prev = e;
+            continue;
+        }
+
+        // Inode inexistente, livre ou já referenciado: a entrada é
+        // considerada pendente (dangling)
+        uint32_t n = e->inode_number;
+        int dangling = n >= NUM_INODES
+            || !test_bit(inode_bitmap, n)
+            || test_bit(shadow_inode_bitmap, n)
+            || (inode_table[n].type != ATTR_FILE && inode_table[n].type != ATTR_DIRECTORY);
+        if (dangling) {
+            fsck_stats.dangling_entries++;
+            if (repair) {
+                drop_entry(prev, e);
+                modified = 1;
+                if (prev) continue;
+            }
+            prev = e;
+            continue;
+        }
+
+        // O tipo gravado na entrada (usado por 'ls') deve ser o do inode
+        if (e->type != inode_table[n].type) {
+            fsck_stats.bad_records++;
+            if (repair) {
+                e->type = inode_table[n].type;
+                modified = 1;
+            }
+        }
+
+        set_bitmap_bit(shadow_inode_bitmap, n);
+        if (inode_table[n].type == ATTR_DIRECTORY) {
+            parent_of[n] = dir_num;
+            dir_queue[(*queue_tail)++] = n;
+        } else {
+            check_blocks(n, repair);
+        }
+        prev = e;
+    }
+    return modified;
+}
+
+// Verifica os blocos de um diretório e suas entradas. Cada diretório é
+// visitado uma única vez.
+static void check_directory(uint32_t dir_num, uint32_t* queue_tail, int repair) {
+    Inode* dir_inode = &inode_table[dir_num];
+
+    // Diretórios crescem de bloco em bloco
+    if (dir_inode->size % BLOCK_SIZE != 0) {
+        fsck_stats.bad_sizes++;
+        if (repair) dir_inode->size = (dir_inode->size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    }
+
+    uint32_t blocks = check_blocks(dir_num, repair);
+    for (uint32_t i = 0; i < blocks; i++) {
+        uint32_t block = block_at(dir_inode, i);
+
+        // O conteúdo é validado entrada por entrada, então um checksum
+        // inválido não impede a leitura; na correção, ele é recalculado
+        int modified = 0;
+        if (!block_csum_ok(block)) {
+            fsck_stats.bad_checksums++;
+            modified = repair;
+        }
+        modified |= check_dir_block(dir_num, get_block_unverified(block), queue_tail, repair);
+        if (modified) mark_dirty_meta(block);
+        put_block(block);
+        // Só a verificação cede o processador entre blocos; a correção roda inteira
+        if (!repair) task_yield();
+    }
+}
+
+// Confere a tabela de referências contra as reivindicações da árvore: uma
+// entrada em bloco livre é descartada e uma contagem errada é corrigida
+static void check_refcounts(int repair) {
+    for (uint32_t b = sb.data_area_start_block; b < sb.total_blocks; b++) {
+        uint32_t ref = refcount_table[b];
+        if (ref == 0) continue;
+        if (!(ref & REF_INDEXED) || !test_bit(shadow_data_bitmap, b)) {
+            fsck_stats.bad_refcounts++;
+            if (repair) refcount_table[b] = 0;
+        } else if ((ref & REF_COUNT_MASK) != extra_claims[b]) {
+            fsck_stats.bad_refcounts++;
+            if (repair) refcount_table[b] = REF_INDEXED | extra_claims[b];
+        }
+    }
+}
+
+// Compara um bitmap real com sua versão sombra, palavra por palavra.
+// Bits presentes apenas no real são vazamentos; bits presentes apenas na
+// sombra são blocos em uso que estão marcados como livres.
+static void reconcile_bitmap(uint32_t* real, const uint32_t* shadow, uint32_t words,
+                             uint32_t* leaked, uint32_t* unmarked, int repair) {
+    for (uint32_t w = 0; w < words; w++) {
+        if (real[w] == shadow[w]) continue;
+        *leaked += count_bits(real[w] & ~shadow[w]);
+        if (unmarked) *unmarked += count_bits(shadow[w] & ~real[w]);
+        if (repair) real[w] = shadow[w];
+    }
+}
+
+static int run_fsck(int repair) {
+    PERF_SCOPE(PERF_FS_FSCK);
+    uint32_t start = timer_now_us();
+
+    memset(&fsck_stats, 0, sizeof(fsck_stats));
+
+    // O superbloco montado é a referência: um gravado com checksum inválido
+    // (montagem somente para leitura) é regravado a partir dele
+    fsck_stats.bad_superblock = superblock_check(repair);
+
+    uint32_t root = sb.root_inode_number;
+    if (root >= NUM_INODES || inode_table[root].type != ATTR_DIRECTORY) {
+        uart_puts("fsck: diretorio raiz invalido, use 'format'.\n");
+        return -1;
+    }
+
+    Arena scratch = ARENA_INIT;
+    shadow_inode_bitmap = arena_alloc(&scratch, INODE_BITMAP_WORDS * sizeof(uint32_t));
+    shadow_data_bitmap = arena_alloc(&scratch, DATA_BITMAP_WORDS * sizeof(uint32_t));
+    dir_queue = arena_alloc(&scratch, NUM_INODES * sizeof(uint32_t));
+    parent_of = arena_alloc(&scratch, NUM_INODES * sizeof(uint32_t));
+    extra_claims = arena_alloc(&scratch, sb.total_blocks * sizeof(uint32_t));
+    if (!shadow_inode_bitmap || !shadow_data_bitmap || !dir_queue || !parent_of || !extra_claims) {
+        uart_puts("fsck: memoria insuficiente.\n");
+        arena_release(&scratch);
+        return -1;
+    }
+
+    // Checksums dos bitmaps e da tabela de inodes, antes de qualquer correção
+    fsck_stats.bad_checksums = csum_verify_meta();
+
+    // Os blocos de metadados estão sempre em uso
+    for (uint32_t i = 0; i < sb.data_area_start_block; i++) {
+        set_bitmap_bit(shadow_data_bitmap, i);
+    }
+
+    // Percurso em largura a partir da raiz, sem recursão
+    uint32_t head = 0, tail = 0;
+    set_bitmap_bit(shadow_inode_bitmap, root);
+    parent_of[root] = root;
+    dir_queue[tail++] = root;
+    while (head < tail) {
+        check_directory(dir_queue[head++], &tail, repair);
+    }
+
+    check_refcounts(repair);
+
+    // Inodes alocados mas inalcançáveis são órfãos: liberá-los também
+    // libera seus blocos, que deixam de constar no bitmap sombra.
+    reconcile_bitmap(inode_bitmap, shadow_inode_bitmap, INODE_BITMAP_WORDS,
+                     &fsck_stats.orphan_inodes, NULL, repair);
+    reconcile_bitmap(data_bitmap, shadow_data_bitmap, DATA_BITMAP_WORDS,
+                     &fsck_stats.leaked_blocks, &fsck_stats.unmarked_blocks, repair);
+    arena_release(&scratch);
+
+    // As correções acima alteram inodes, bitmaps e referências diretamente
+    if (repair) {
+        csum_rebuild_meta();
+        dedup_mount();
+    }
+
+    uint32_t elapsed = timer_now_us() - start;
+    uint32_t problems = fsck_stats.bad_superblock + fsck_stats.bad_pointers + fsck_stats.double_allocated
+        + fsck_stats.dangling_entries + fsck_stats.bad_records + fsck_stats.bad_dot_entries + fsck_stats.bad_sizes
+        + fsck_stats.orphan_inodes + fsck_stats.leaked_blocks + fsck_stats.unmarked_blocks
+        + fsck_stats.bad_checksums + fsck_stats.bad_refcounts;
+
+    uart_puts("--- Verificacao do Sistema de Arquivos ---\n");
+    uart_puts_aligned(" Diretorios visitados", tail, -1, NULL);
+    uart_puts_aligned(" Superbloco invalido", fsck_stats.bad_superblock, -1, NULL);
+    uart_puts_aligned(" Ponteiros invalidos", fsck_stats.bad_pointers, -1, NULL);
+    uart_puts_aligned(" Blocos duplamente alocados", fsck_stats.double_allocated, -1, NULL);
+    uart_puts_aligned(" Entradas pendentes", fsck_stats.dangling_entries, -1, NULL);
+    uart_puts_aligned(" Registros de diretorio invalidos", fsck_stats.bad_records, -1, NULL);
+    uart_puts_aligned(" Entradas '.'/'..' incorretas", fsck_stats.bad_dot_entries, -1, NULL);
+    uart_puts_aligned(" Tamanhos invalidos", fsck_stats.bad_sizes, -1, NULL);
+    uart_puts_aligned(" Inodes orfaos", fsck_stats.orphan_inodes, -1, NULL);
+    uart_puts_aligned(" Blocos vazados", fsck_stats.leaked_blocks, -1, NULL);
+    uart_puts_aligned(" Blocos em uso marcados livres", fsck_stats.unmarked_blocks, -1, NULL);
+    uart_puts_aligned(" Checksums invalidos", fsck_stats.bad_checksums, -1, NULL);
+    uart_puts_aligned(" Referencias de dedup incorretas", fsck_stats.bad_refcounts, -1, NULL);
+    uart_puts_aligned(" Tempo de execucao", elapsed, -1, " us");
+    if (problems == 0) {
+        uart_puts("Nenhum problema encontrado.\n");
+    } else if (repair) {
+        uart_puts("Problemas corrigidos.\n");
+    } else {
+        uart_puts("Use 'fsck -r' para corrigir.\n");
+    }
+    uart_puts("-------------------------------------------\n");
+
+    return problems;
+}
+
+int fs_fsck(int repair) {
+    // As tabelas da verificação são globais: uma execução por vez
+    static int running = 0;
+    if (running) {
+        uart_puts("fsck: ja em execucao.\n");
+        return -1;
+    }
+    running = 1;
+    int problems = run_fsck(repair);
+    running = 0;
+    return problems;
+}
@@ -0,0 +1,202 @@
+#include "sfs.h"
+#include "common.h"
+#include "uart.h"
+#include "fs_defs.h"
+#include "walk.h"
+#include "timer.h"
+#include "task.h"
+
+// Trecho mostrado de cada linha com ocorrência; antes da ocorrência, no
+// máximo metade dele
+#define GREP_LINE_MAX 160
+
+typedef struct {
+    const char* pattern;
+    uint32_t pattern_len;
+    int recursive;
+    uint32_t bytes;          // Bytes de dados examinados
+    uint32_t files;
+    uint32_t matched_files;
+    uint32_t lines;          // Linhas com ocorrência
+    uint32_t output_us;      // Tempo gasto mostrando as linhas
+} GrepState;
+
+// Compara o padrão com o arquivo a partir de 'pos', direto nos blocos e
+// atravessando as fronteiras entre eles
+static int match_at(uint32_t inode_num, uint32_t pos, const char* pattern, uint32_t len) {
+    while (len > 0) {
+        uint32_t off = pos % BLOCK_SIZE;
+        uint32_t chunk = BLOCK_SIZE - off;
+        if (chunk > len) chunk = len;
+        uint32_t block = bmap(inode_num, pos / BLOCK_SIZE, 0);
+        if (block == 0) return 0;   // Buraco: só zeros, que o padrão não tem
+        const char* data = get_block(block);
+        if (!data) return 0;
+        int diff = memcmp(data + off, pattern, chunk);
+        put_block(block);
+        if (diff) return 0;
+        pos += chunk;
+        pattern += chunk;
+        len -= chunk;
+    }
+    return 1;
+}
+
+// Copia 'len' bytes do arquivo a partir de 'pos' (buracos leem como zeros)
+static void read_span(uint32_t inode_num, uint32_t pos, char* out, uint32_t len) {
+    while (len > 0) {
+        uint32_t off = pos % BLOCK_SIZE;
+        uint32_t chunk = BLOCK_SIZE - off;
+        if (chunk > len) chunk = len;
+        uint32_t block = bmap(inode_num, pos / BLOCK_SIZE, 0);
+        const char* data = block ? get_block(block) : NULL;
+        if (data) {
+            memcpy(out, data + off, chunk);
+            put_block(block);
+        } else {
+            memset(out, 0, chunk);
+        }
+        pos += chunk;
+        out += chunk;
+        len -= chunk;
+    }
+}
+
+// Posição do '\n' que termina a linha de 'pos', ou o tamanho do arquivo
+static uint32_t line_end(uint32_t inode_num, uint32_t pos, uint32_t size) {
+    while (pos < size) {
+        uint32_t off = pos % BLOCK_SIZE;
+        uint32_t chunk = BLOCK_SIZE - off;
+        if (chunk > size - pos) chunk = size - pos;
+        uint32_t block = bmap(inode_num, pos / BLOCK_SIZE, 0);
+        const char* data = block ? get_block(block) : NULL;
+        if (data) {
+            const char* nl = memchr(data + off, '\n', chunk);
+            put_block(block);
+            if (nl) return pos + (nl - (data + off));
+        }
+        pos += chunk;
+    }
+    return size;
+}
+
+// Mostra "caminho:linha", cortando a linha em GREP_LINE_MAX bytes em torno
+// da ocorrência. Devolve o fim da linha.
+static uint32_t print_line(uint32_t inode_num, const char* path, uint32_t pos, uint32_t size) {
+    char buf[GREP_LINE_MAX];
+    uint32_t start = pos > GREP_LINE_MAX / 2 ? pos - GREP_LINE_MAX / 2 : 0;
+    read_span(inode_num, start, buf, pos - start);
+    uint32_t i = pos - start;
+    while (i > 0 && buf[i - 1] != '\n') i--;
+    int cut_before = (i == 0 && start > 0);
+    start += i;
+
+    uint32_t end = line_end(inode_num, pos, size);
+    uint32_t len = end - start;
+    int cut_after = len > GREP_LINE_MAX;
+    if (cut_after) len = GREP_LINE_MAX;
+    read_span(inode_num, start, buf, len);
+
+    uart_puts(path);
+    uart_puts(cut_before ? ":..." : ":");
+    uart_write(buf, len);
+    uart_puts(cut_after ? "...\n" : "\n");
+    return end;
+}
+
+// Procura o padrão em um arquivo que o chamador já travou
+static void grep_file(GrepState* g, uint32_t inode_num, const char* path) {
+    uint32_t size = inode_table[inode_num].size;
+    uint32_t plen = g->pattern_len;
+    char first = g->pattern[0];
+    uint32_t lines = g->lines;
+    uint32_t resume = 0;     // Onde voltar a procurar: depois da última linha mostrada
+    g->files++;
+
+    for (uint32_t i = 0; i < MAX_FILE_BLOCKS && i * BLOCK_SIZE < size; i++) {
+        uint32_t base = i * BLOCK_SIZE;
+        uint32_t len = size - base < BLOCK_SIZE ? size - base : BLOCK_SIZE;
+        g->bytes += len;
+        if (resume >= base + len) continue;
+        uint32_t block = bmap(inode_num, i, 0);
+        if (block == 0) continue;
+        const char* data = get_block(block);
+        if (!data) continue;
+
+        // Filtro pelo primeiro byte (memchr, uma palavra por vez); o resto
+        // do padrão é comparado no próprio bloco ou, se passar do fim dele,
+        // nos blocos seguintes
+        uint32_t off = resume > base ? resume - base : 0;
+        while (off < len) {
+            const char* hit = memchr(data + off, first, len - off);
+            if (!hit) break;
+            uint32_t pos = base + (hit - data);
+            off = hit - data + 1;
+            if (pos + plen > size) break;
+            int found = (off - 1 + plen <= len)
+                ? memcmp(hit, g->pattern, plen) == 0
+                : match_at(inode_num, pos, g->pattern, plen);
+            if (!found) continue;
+
+            uint32_t t0 = timer_now_us();
+            resume = print_line(inode_num, path, pos, size) + 1;
+            g->output_us += timer_now_us() - t0;
+            g->lines++;
+            if (resume >= base + len) break;
+            off = resume - base;
+        }
+        put_block(block);
+        task_yield();
+    }
+    if (g->lines != lines) g->matched_files++;
+}
+
+static int grep_visit(const WalkEntry* entry, int when, void* arg) {
+    GrepState* g = arg;
+    if (when != WALK_PRE) return 0;
+    if (entry->type == ATTR_DIRECTORY) return g->recursive ? 0 : WALK_SKIP;
+    INODE_GUARD(entry->inode_num);
+    grep_file(g, entry->inode_num, entry->path);
+    return 0;
+}
+
+int fs_grep(const char* pattern, const char* name, int recursive) {
+    if (pattern[0] == '\0') {
+        uart_puts("Erro: Padrao vazio.\n");
+        return -1;
+    }
+    int target = lock_entry(name);
+    if (target == -1) {
+        uart_puts("Erro: Arquivo ou diretorio nao encontrado.\n");
+        return -1;
+    }
+    INODE_GUARD_HELD(target);
+    if (!name) name = ".";
+
+    GrepState g = { pattern, strlen(pattern), recursive, 0, 0, 0, 0, 0 };
+    uint32_t start = timer_now_us();
+    int result = 0;
+    if (inode_table[target].type != ATTR_DIRECTORY) {
+        grep_file(&g, target, name);
+    } else {
+        result = fs_walk(target, name, grep_visit, &g);
+    }
+    uint32_t us = timer_now_us() - start - g.output_us;
+
+    if (result != 0) {
+        uart_puts("Erro: Diretorio corrompido. Use 'fsck -r'.\n");
+        return -1;
+    }
+    if (g.lines == 0) uart_puts("Nenhuma ocorrencia encontrada.\n");
+
+    // Bytes por milissegundo = KB/s; sem estourar 32 bits acima de 4 MB
+    if (us == 0) us = 1;
+    uint32_t kbps = g.bytes < 4000000 ? udiv32(g.bytes * 1000, us)
+                                      : udiv32(g.bytes, us / 1000 ? us / 1000 : 1);
+    uart_puts_aligned(" Linhas encontradas", g.lines, -1, NULL);
+    uart_puts_aligned(" Arquivos com ocorrencias", g.matched_files, g.files, NULL);
+    uart_puts_aligned(" Bytes examinados", g.bytes, -1, " Bytes");
+    uart_puts_aligned(" Tempo de busca", us, -1, " us");
+    uart_puts_aligned(" Vazao da busca", kbps, -1, " KB/s");
+    return g.lines;
+}
@@ -2,89 +2,401 @@
 #include "common.h"
 #include "uart.h"
 #include "fs_defs.h"
+#include "perf.h"
+#include "blktrace.h"
+#include "atomic.h"
+#include "crc32.h"
+#include "dedup.h"
+#include "blksync.h"
+#include "flash.h"
 
-// O "DISCO" VIRTUAL
-unsigned char ram_disk[NUM_DATA_BLOCKS * BLOCK_SIZE];
+// O "DISCO" VIRTUAL. Fica em .noinit, em endereço fixo e fora da zeragem
+// do .bss, para que uma reinicialização a quente encontre o disco intacto.
+// A área comporta o maior disco e é a última de .noinit (ver linker.ld); só
+// os primeiros disk_capacity blocos são formatados.
+unsigned char ram_disk[DISK_MAX_BLOCKS * BLOCK_SIZE] __attribute__((section(".noinit.disk")));
+static uint32_t disk_capacity = DISK_DEFAULT_BLOCKS;
 
 // ESTADO GLOBAL DO SISTEMA DE ARQUIVOS
 Superblock sb;
 uint32_t *inode_bitmap;
 uint32_t *data_bitmap;
 Inode *inode_table;
+uint32_t *csum_table;
+uint32_t *refcount_table;
 void *data_area;
-uint32_t current_dir_inode_num;
-char current_path_string[256];
+
+// Blocos de metadados cujo checksum não conferiu desde o boot
+uint32_t csum_errors;
+
+// Blocos cujo checksum já foi conferido desde a montagem ou recalculado
+// desde então. Faz o papel de uma cache de blocos: a verificação custa um
+// CRC na primeira leitura, e não em toda busca. A montagem e o fsck
+// verificam todos os blocos outra vez.
+static uint32_t csum_verified[DISK_BITMAP_WORDS];
+
+// Locks que serializam a atualização de checksums, distribuídos por bloco
+#define CSUM_LOCKS 16
+static Spinlock csum_locks[CSUM_LOCKS];
+
+// Contexto usado por quem não definiu o seu (o shell, no alvo)
+// Superbloco com checksum inválido na montagem: nada é gravado até 'fsck -r'
+static int readonly;
+
+static FsContext fs_default_context;
+FS_CONTEXT_LOCAL FsContext *fs_ctx = &fs_default_context;
+
+// Um lock por inode, protegendo seu conteúdo e, para diretórios, suas entradas
+static Spinlock inode_locks[NUM_INODES];
 
 // FUNÇÕES AUXILIARES DE BAIXO NÍVEL
 
+// Um bloco mudou: entra na próxima exportação e na próxima sincronização
+// com o dispositivo flash
+static void block_changed(uint32_t block_num) {
+    blksync_mark(block_num);
+    flash_mark(block_num);
+}
+
 // Lê um bloco do disco para um buffer
 void read_block(uint32_t block_num, void* buffer) {
+    PERF_SCOPE(PERF_READ_BLOCK);
+    blktrace_record(block_num, BLKTRACE_READ);
     memcpy(buffer, &ram_disk[block_num * BLOCK_SIZE], BLOCK_SIZE);
 }
 
 // Escreve o conteúdo de um buffer em um bloco do disco
 void write_block(uint32_t block_num, const void* buffer) {
+    PERF_SCOPE(PERF_WRITE_BLOCK);
+    blktrace_record(block_num, BLKTRACE_WRITE);
+    block_changed(block_num);
     memcpy(&ram_disk[block_num * BLOCK_SIZE], buffer, BLOCK_SIZE);
 }
 
+// CRC-32 do conteúdo atual do bloco; 0 é reservado para "sem checksum"
+static uint32_t block_csum(uint32_t block_num) {
+    PERF_SCOPE(PERF_BLOCK_CSUM);
+    uint32_t crc = crc32(0, &ram_disk[block_num * BLOCK_SIZE], BLOCK_SIZE);
+    return crc ? crc : 1;
+}
+
+int block_csum_ok(uint32_t block_num) {
+    return !csum_table || csum_table[block_num] == 0
+        || csum_table[block_num] == block_csum(block_num);
+}
+
+// Mapeia um bloco para acesso direto, sem cópia, sem verificar o checksum
+void* get_block_unverified(uint32_t block_num) {
+    blktrace_record(block_num, BLKTRACE_READ);
+    return &ram_disk[block_num * BLOCK_SIZE];
+}
+
+// Mapeia um bloco, recusando blocos de metadados corrompidos
+void* get_block(uint32_t block_num) {
+    void* block = get_block_unverified(block_num);
+    if (!csum_table || csum_table[block_num] == 0
+        || (csum_verified[block_num / 32] >> (block_num % 32)) & 1) {
+        return block;
+    }
+    if (!block_csum_ok(block_num)) {
+        char buf[12];
+        itoa(block_num, buf);
+        uart_puts("ERRO: Checksum invalido no bloco ");
+        uart_puts(buf);
+        uart_puts(". Use 'fsck -r'.\n");
+        atomic_fetch_add32(&csum_errors, 1);
+        return NULL;
+    }
+    set_bitmap_bit(csum_verified, block_num);
+    return block;
+}
+
+// Registra que o bloco mapeado foi alterado
+void mark_dirty(uint32_t block_num) {
+    blktrace_record(block_num, BLKTRACE_WRITE);
+    block_changed(block_num);
+}
+
+// A entrada de 'block_num' na tabela de checksums mudou: o bloco da tabela
+// que a contém também mudou
+static void csum_entry_changed(uint32_t block_num) {
+    block_changed(sb.csum_table_start_block + block_num / (BLOCK_SIZE / sizeof(uint32_t)));
+}
+
+// Registra um checksum já calculado pelo chamador (ex.: a deduplicação, que
+// usa o CRC do bloco como fingerprint)
+void csum_set(uint32_t block_num, uint32_t csum) {
+    Spinlock* lock = &csum_locks[block_num % CSUM_LOCKS];
+    spin_lock(lock);
+    csum_table[block_num] = csum;
+    set_bitmap_bit(csum_verified, block_num);
+    spin_unlock(lock);
+    csum_entry_changed(block_num);
+}
+
+// Registra a alteração de um bloco de metadados e recalcula seu checksum.
+// O cálculo é serializado por bloco: o último a terminar vê todas as alterações.
+void mark_dirty_meta(uint32_t block_num) {
+    blktrace_record(block_num, BLKTRACE_WRITE);
+    block_changed(block_num);
+    if (!csum_table) return;
+    Spinlock* lock = &csum_locks[block_num % CSUM_LOCKS];
+    spin_lock(lock);
+    csum_table[block_num] = block_csum(block_num);
+    set_bitmap_bit(csum_verified, block_num);
+    spin_unlock(lock);
+    csum_entry_changed(block_num);
+}
+
+// Um inode pode ocupar o fim de um bloco da tabela e o início do seguinte
+void mark_inode_dirty(uint32_t inode_num) {
+    uint32_t first = (inode_num * sizeof(Inode)) / BLOCK_SIZE;
+    uint32_t last = ((inode_num + 1) * sizeof(Inode) - 1) / BLOCK_SIZE;
+    for (uint32_t i = first; i <= last; i++) {
+        mark_dirty_meta(sb.inode_table_start_block + i);
+    }
+}
+
+// Encerra o mapeamento; no backend em RAM não há nada a devolver
+void put_block(uint32_t block_num) {
+    (void)block_num;
+}
+
 // Define um bit em um bitmap
 void set_bitmap_bit(uint32_t* bitmap, uint32_t index) {
-    bitmap[index / 32] |= (1 << (index % 32));
+    atomic_fetch_or32(&bitmap[index / 32], 1u << (index % 32));
 }
 
 // Limpa (zera) um bit em um bitmap
 void clear_bitmap_bit(uint32_t* bitmap, uint32_t index) {
-    bitmap[index / 32] &= ~(1 << (index % 32));
+    atomic_fetch_and32(&bitmap[index / 32], ~(1u << (index % 32)));
+}
+
+// Cada palavra é limpa com uma única operação atômica: só a primeira e a
+// última da sequência podem ser parciais
+void bitmap_clear_range(uint32_t* bitmap, uint32_t start, uint32_t count) {
+    while (count > 0) {
+        uint32_t bit = start % 32;
+        uint32_t n = (32 - bit < count) ? 32 - bit : count;
+        uint32_t mask = (n == 32) ? 0xFFFFFFFF : ((1u << n) - 1) << bit;
+        atomic_fetch_and32(&bitmap[start / 32], ~mask);
+        start += n;
+        count -= n;
+    }
 }
 
-// Encontra o primeiro inode livre no bitmap
-int find_free_inode() {
-    for (int i = 0; i < NUM_INODES; i++) {
-        if (!((inode_bitmap[i / 32] >> (i % 32)) & 1)) {
-            return i;
+// Reserva o primeiro bit livre do bitmap com compare-and-swap. Palavras
+// cheias são puladas inteiras; se outro contexto ganhar a corrida pela
+// palavra, ela é relida e a busca continua no mesmo ponto.
+static int bitmap_alloc(uint32_t* bitmap, uint32_t nbits) {
+    for (uint32_t w = 0; w < (nbits + 31) / 32; w++) {
+        uint32_t word = bitmap[w];
+        while (word != 0xFFFFFFFF) {
+            uint32_t bit = __builtin_ctz(~word);
+            if (w * 32 + bit >= nbits) return -1;
+            if (atomic_cas32(&bitmap[w], word, word | (1u << bit))) {
+                return w * 32 + bit;
+            }
+            word = bitmap[w];
         }
     }
-    return -1; // Nenhum inode livre
+    return -1;
+}
+
+// Atualiza o checksum do bloco do bitmap que contém o bit 'index'
+static void mark_bitmap_dirty(uint32_t start_block, uint32_t index) {
+    mark_dirty_meta(start_block + index / (BLOCK_SIZE * 8));
+}
+
+int alloc_inode() {
+    int inode_num = bitmap_alloc(inode_bitmap, NUM_INODES);
+    if (inode_num != -1) mark_bitmap_dirty(sb.inode_bitmap_start_block, inode_num);
+    return inode_num;
+}
+
+// Um bloco recém-alocado começa sem checksum; se for um diretório, quem o
+// preencher o registra com mark_dirty_meta.
+int alloc_data_block() {
+    int block_num = bitmap_alloc(data_bitmap, sb.total_blocks);
+    if (block_num != -1) {
+        csum_table[block_num] = 0;
+        csum_entry_changed(block_num);
+        mark_bitmap_dirty(sb.data_bitmap_start_block, block_num);
+    }
+    return block_num;
 }
 
-// Encontra o primeiro bloco de dados livre no bitmap
-int find_free_data_block() {
-    for (int i = 0; i < NUM_DATA_BLOCKS; i++) {
-        if (!((data_bitmap[i / 32] >> (i % 32)) & 1)) {
-            return i;
+void free_inode(uint32_t inode_num) {
+    clear_bitmap_bit(inode_bitmap, inode_num);
+    mark_bitmap_dirty(sb.inode_bitmap_start_block, inode_num);
+}
+
+void free_data_block(uint32_t block_num) {
+    free_data_blocks(block_num, 1);
+}
+
+// Devolve a sequência ao bitmap. O checksum de cada bloco do bitmap afetado
+// é recalculado uma única vez.
+static void release_blocks(uint32_t start, uint32_t count) {
+    if (count == 0) return;
+    memset(&csum_table[start], 0, count * sizeof(uint32_t));
+    for (uint32_t b = start; b < start + count; b += BLOCK_SIZE / sizeof(uint32_t)) {
+        csum_entry_changed(b);
+    }
+    csum_entry_changed(start + count - 1);
+    bitmap_clear_range(data_bitmap, start, count);
+    uint32_t first = start / (BLOCK_SIZE * 8);
+    uint32_t last = (start + count - 1) / (BLOCK_SIZE * 8);
+    for (uint32_t b = first; b <= last; b++) {
+        mark_dirty_meta(sb.data_bitmap_start_block + b);
+    }
+}
+
+// Blocos compartilhados pela deduplicação só perdem uma referência; os
+// demais são devolvidos em sequências contíguas
+void free_data_blocks(uint32_t start, uint32_t count) {
+    uint32_t run_start = start;
+    for (uint32_t b = start; b < start + count; b++) {
+        if (dedup_unref(b)) {
+            release_blocks(run_start, b - run_start);
+            run_start = b + 1;
         }
     }
-    return -1; // Nenhum bloco de dados livre
+    release_blocks(run_start, start + count - run_start);
+}
+
+void inode_lock(uint32_t inode_num) {
+    spin_lock(&inode_locks[inode_num]);
+}
+
+void inode_unlock(uint32_t inode_num) {
+    spin_unlock(&inode_locks[inode_num]);
+}
+
+uint32_t inode_guard_acquire(uint32_t inode_num) {
+    inode_lock(inode_num);
+    return inode_num;
+}
+
+void inode_guard_release(uint32_t* inode_num) {
+    inode_unlock(*inode_num);
 }
 
 // FUNÇÕES AUXILIARES DO DISCO VIRTUAL
 
-void fs_format() {
-    // 1. Configurar o superbloco
-    sb.magic_number = FS_MAGIC;
-    sb.total_blocks = NUM_DATA_BLOCKS;
-    sb.inode_bitmap_start_block = 1;
-    sb.data_bitmap_start_block = 2;
-    sb.inode_table_start_block = 3;
-    sb.root_inode_number = 0;
-
-    // Calcula o início da área de dados
+// O superbloco ocupa só o início do bloco 0; o restante fica zerado.
+// Ele tem seu próprio checksum, fora da tabela.
+static uint32_t superblock_csum() {
+    uint32_t saved = sb.checksum;
+    sb.checksum = 0;
+    uint32_t crc = crc32(0, &sb, sizeof(Superblock));
+    sb.checksum = saved;
+    return crc;
+}
+
+// Campos do superbloco que dependem só do número de blocos
+static void superblock_layout(Superblock* s, uint32_t total_blocks) {
     uint32_t inode_table_blocks = (NUM_INODES * sizeof(Inode) + BLOCK_SIZE - 1) / BLOCK_SIZE;
-    sb.data_area_start_block = sb.inode_table_start_block + inode_table_blocks;
+    s->magic_number = FS_MAGIC;
+    s->total_blocks = total_blocks;
+    s->inode_bitmap_start_block = 1;
+    s->data_bitmap_start_block = s->inode_bitmap_start_block + INODE_BITMAP_BLOCKS;
+    s->inode_table_start_block = s->data_bitmap_start_block + DATA_BITMAP_BLOCKS(total_blocks);
+    s->root_inode_number = 0;
+    s->refcount_table_start_block = s->inode_table_start_block + inode_table_blocks;
+    s->csum_table_start_block = s->refcount_table_start_block + REFCOUNT_TABLE_BLOCKS(total_blocks);
+    s->data_area_start_block = s->csum_table_start_block + CSUM_TABLE_BLOCKS(total_blocks);
+}
+
+// Tamanho de um superbloco com checksum inválido: o gravado, se couber na
+// capacidade; senão, o padrão ou a capacidade, o que reproduzir o início da
+// área de dados gravado (o resto da geometria sai do tamanho)
+static uint32_t recover_total_blocks() {
+    if (sb.total_blocks >= DISK_DEFAULT_BLOCKS && sb.total_blocks <= disk_capacity) {
+        return sb.total_blocks;
+    }
+    Superblock guess;
+    superblock_layout(&guess, DISK_DEFAULT_BLOCKS);
+    if (guess.data_area_start_block == sb.data_area_start_block) return DISK_DEFAULT_BLOCKS;
+    return disk_capacity;
+}
+
+static void read_superblock() {
+    memcpy(&sb, get_block_unverified(0), sizeof(Superblock));
+    put_block(0);
+}
+
+static void write_superblock() {
+    sb.checksum = superblock_csum();
+    char* block = get_block_unverified(0);
+    memset(block, 0, BLOCK_SIZE);
+    memcpy(block, &sb, sizeof(Superblock));
+    mark_dirty(0);
+    put_block(0);
+}
 
-    // Escreve o superbloco
-    write_block(0, &sb);
+// Zera um bloco no próprio backend
+static void zero_block(uint32_t block_num) {
+    memset(get_block_unverified(block_num), 0, BLOCK_SIZE);
+    mark_dirty(block_num);
+    put_block(block_num);
+}
+
+// Recalcula os checksums dos bitmaps, da tabela de inodes e da de referências
+void csum_rebuild_meta() {
+    for (uint32_t b = sb.inode_bitmap_start_block; b < sb.csum_table_start_block; b++) {
+        mark_dirty_meta(b);
+    }
+}
+
+// Verifica os blocos cobertos por csum_rebuild_meta; retorna quantos falharam
+uint32_t csum_verify_meta() {
+    uint32_t bad = 0;
+    for (uint32_t b = sb.inode_bitmap_start_block; b < sb.csum_table_start_block; b++) {
+        if (!block_csum_ok(b)) bad++;
+    }
+    return bad;
+}
+
+// Configura os ponteiros para as áreas de metadados na RAM
+static void map_metadata() {
+    inode_bitmap = (uint32_t*)&ram_disk[sb.inode_bitmap_start_block * BLOCK_SIZE];
+    data_bitmap = (uint32_t*)&ram_disk[sb.data_bitmap_start_block * BLOCK_SIZE];
+    inode_table = (Inode*)&ram_disk[sb.inode_table_start_block * BLOCK_SIZE];
+    csum_table = (uint32_t*)&ram_disk[sb.csum_table_start_block * BLOCK_SIZE];
+    refcount_table = (uint32_t*)&ram_disk[sb.refcount_table_start_block * BLOCK_SIZE];
+    data_area = &ram_disk[sb.data_area_start_block * BLOCK_SIZE];
+}
+
+void fs_format() {
+    PERF_SCOPE(PERF_FS_FORMAT);
+    // Os metadados ficam desmapeados (e sem checksums) até serem recriados
+    csum_table = NULL;
+
+    // 1. Configurar e escrever o superbloco
+    superblock_layout(&sb, disk_capacity);
+    write_superblock();
+    readonly = 0;
 
     // 2. Limpa os bitmaps e a tabela de inodes
-    char empty_block[BLOCK_SIZE] = {0};
-    write_block(sb.inode_bitmap_start_block, empty_block);
-    write_block(sb.data_bitmap_start_block, empty_block);
-    for (uint32_t i = 0; i < inode_table_blocks; i++) {
-        write_block(sb.inode_table_start_block + i, empty_block);
+    for (uint32_t i = 0; i < INODE_BITMAP_BLOCKS; i++) {
+        zero_block(sb.inode_bitmap_start_block + i);
+    }
+    for (uint32_t i = 0; i < DATA_BITMAP_BLOCKS(sb.total_blocks); i++) {
+        zero_block(sb.data_bitmap_start_block + i);
+    }
+    for (uint32_t i = sb.inode_table_start_block; i < sb.refcount_table_start_block; i++) {
+        zero_block(i);
+    }
+    for (uint32_t i = 0; i < REFCOUNT_TABLE_BLOCKS(sb.total_blocks); i++) {
+        zero_block(sb.refcount_table_start_block + i);
+    }
+    for (uint32_t i = 0; i < CSUM_TABLE_BLOCKS(sb.total_blocks); i++) {
+        zero_block(sb.csum_table_start_block + i);
     }
 
-    // Monta para ter os ponteiros corretos
-    fs_mount();
+    // Configura os ponteiros para as áreas de metadados
+    map_metadata();
 
     // 3. Reservar blocos para metadados
     for(uint32_t i = 0; i < sb.data_area_start_block; i++) {
@@ -92,68 +404,446 @@ void fs_format() {
     }
 
     // 4. Criar o diretório raiz
-    int root_inode_idx = find_free_inode(); // Deve ser 0
-    set_bitmap_bit(inode_bitmap, root_inode_idx);
+    int root_inode_idx = alloc_inode(); // Deve ser 0
 
-    int root_data_block_idx = find_free_data_block();
-    set_bitmap_bit(data_bitmap, root_data_block_idx);
+    // Configura o inode raiz (a tabela acabou de ser zerada) e cria as
+    // entradas "." e "..", ambas apontando para a própria raiz
+    inode_table[root_inode_idx].type = ATTR_DIRECTORY;
+    dir_init_block(root_inode_idx, root_inode_idx);
 
-    // Configura o inode raiz
-    Inode root_inode;
-    root_inode.type = 2; // Diretório
-    root_inode.size = 2 * sizeof(DirectoryEntry);
-    root_inode.direct_pointers[0] = root_data_block_idx;
-    for(int i = 1; i < MAX_DIRECT_POINTERS; i++) root_inode.direct_pointers[i] = 0;
+    // 5. Checksums dos bitmaps e da tabela de inodes recém-criados
+    csum_rebuild_meta();
 
-    // Cria as entradas "." e ".."
-    DirectoryEntry root_entries[2];
-    strcpy(root_entries[0].filename, ".");
-    root_entries[0].inode_number = root_inode_idx;
-    strcpy(root_entries[1].filename, "..");
-    root_entries[1].inode_number = root_inode_idx;
+    // O disco pode ter mudado de tamanho (fs_set_capacity)
+    flash_resize();
+}
 
-    // Escreve tudo no disco
-    inode_table[root_inode_idx] = root_inode;
-    write_block(root_data_block_idx, root_entries);
+void fs_set_capacity(uint32_t blocks) {
+    if (blocks > DISK_MAX_BLOCKS) blocks = DISK_MAX_BLOCKS;
+    if (blocks < DISK_DEFAULT_BLOCKS) blocks = DISK_DEFAULT_BLOCKS;
+    disk_capacity = blocks;
 }
 
-void fs_mount() {
+uint32_t fs_capacity() {
+    return disk_capacity;
+}
+
+int fs_check_writable() {
+    if (!readonly) return 0;
+    uart_puts("Erro: Disco somente para leitura (superbloco invalido). Use 'fsck -r'.\n");
+    return -1;
+}
+
+int superblock_check(int repair) {
+    Superblock disk;
+    memcpy(&disk, get_block_unverified(0), sizeof(Superblock));
+    put_block(0);
+    uint32_t saved = sb.checksum;
+    sb.checksum = disk.checksum;
+    int damaged = memcmp(&disk, &sb, sizeof(Superblock)) != 0 || disk.checksum != superblock_csum();
+    sb.checksum = saved;
+    if (damaged && repair) {
+        write_superblock();
+        readonly = 0;
+    }
+    return damaged;
+}
+
+int fs_mount() {
+    return fs_mount_opts(MOUNT_DEFAULT_OPTS);
+}
+
+// Retorna 1 se o disco não tinha um sistema de arquivos válido e foi formatado
+int fs_mount_opts(uint32_t opts) {
+    PERF_SCOPE(PERF_FS_MOUNT);
+    int formatted = 0;
+
     // Lê o superbloco do disco
-    read_block(0, &sb);
+    read_superblock();
+    readonly = 0;
     if (sb.magic_number != FS_MAGIC) {
-        uart_puts("ERRO: Magic number invalido! Formatando o disco...\n");
+        uart_puts("Nenhum sistema de arquivos no disco. Formatando...\n");
+        formatted = 1;
+    } else if (sb.checksum != superblock_csum()) {
+        // Um bit trocado não apaga o disco: a geometria é refeita a partir do
+        // tamanho e nada é gravado até 'fsck -r' regravar o superbloco
+        uart_puts("ERRO: Checksum do superbloco invalido! Disco montado somente para leitura; use 'fsck -r'.\n");
+        superblock_layout(&sb, recover_total_blocks());
+        readonly = 1;
+    } else if (sb.total_blocks > disk_capacity || sb.data_area_start_block >= sb.total_blocks) {
+        uart_puts("Disco maior que a memoria reservada a ele. Formatando...\n");
+        formatted = 1;
+    }
+    if (formatted) {
         fs_format();
-        read_block(0, &sb);
+        read_superblock();
     }
 
-    // Configura os ponteiros para as áreas de metadados na RAM
-    inode_bitmap = (uint32_t*)&ram_disk[sb.inode_bitmap_start_block * BLOCK_SIZE];
-    data_bitmap = (uint32_t*)&ram_disk[sb.data_bitmap_start_block * BLOCK_SIZE];
-    inode_table = (Inode*)&ram_disk[sb.inode_table_start_block * BLOCK_SIZE];
-    data_area = &ram_disk[sb.data_area_start_block * BLOCK_SIZE];
+    map_metadata();
+
+    // Os diretórios são verificados na primeira leitura; o resto dos metadados, aqui
+    memset(csum_verified, 0, sizeof(csum_verified));
+    uint32_t bad = csum_verify_meta();
+    if (bad > 0) {
+        char buf[12];
+        itoa(bad, buf);
+        uart_puts("AVISO: ");
+        uart_puts(buf);
+        uart_puts(" blocos de metadados com checksum invalido. Use 'fsck -r'.\n");
+        csum_errors += bad;
+    }
 
-    current_dir_inode_num = sb.root_inode_number;
-    strcpy(current_path_string, "/");
+    // O índice de fingerprints em memória é refeito a partir do disco
+    dedup_mount();
+    blksync_mount();
+    flash_resize();
+
+    fs_context_init(fs_ctx);
+
+    if (opts & MOUNT_CHECK) {
+        fs_fsck(opts & MOUNT_REPAIR);
+    }
+    return formatted;
+}
+
+// Bloco indireto do inode, alocado se preciso com 'alloc' (0 se não houver).
+// É metadado: começa zerado e tem checksum.
+static uint32_t indirect_block(Inode* inode, int alloc) {
+    if (inode->indirect_pointer == 0 && alloc) {
+        int block = alloc_data_block();
+        if (block == -1) return 0;
+        memset(get_block_unverified(block), 0, BLOCK_SIZE);
+        mark_dirty_meta(block);
+        put_block(block);
+        inode->indirect_pointer = block;
+    }
+    return inode->indirect_pointer;
 }
 
-int find_entry(const char* name, DirectoryEntry* entry) {
-    Inode current_dir_inode = inode_table[current_dir_inode_num];
-    DirectoryEntry dir_block[BLOCK_SIZE / sizeof(DirectoryEntry)];
+uint32_t bmap(uint32_t inode_num, uint32_t index, int alloc) {
+    Inode* inode = &inode_table[inode_num];
+
+    if (index < MAX_DIRECT_POINTERS) {
+        if (inode->direct_pointers[index] == 0 && alloc) {
+            int block = alloc_data_block();
+            if (block == -1) return 0;
+            inode->direct_pointers[index] = block;
+        }
+        return inode->direct_pointers[index];
+    }
+
+    index -= MAX_DIRECT_POINTERS;
+    if (index >= POINTERS_PER_BLOCK) return 0;
+
+    uint32_t indirect = indirect_block(inode, alloc);
+    if (indirect == 0) return 0;
+    uint32_t* pointers = get_block(indirect);
+    if (!pointers) return 0;
+    uint32_t block = pointers[index];
+    if (block == 0 && alloc) {
+        int new_block = alloc_data_block();
+        if (new_block != -1) {
+            block = pointers[index] = new_block;
+            mark_dirty_meta(indirect);
+        }
+    }
+    put_block(indirect);
+    return block;
+}
+
+// Sequência de blocos contíguos a liberar
+typedef struct {
+    uint32_t start;
+    uint32_t count;
+} BlockRun;
+
+// Acrescenta o bloco à sequência, ou libera a sequência e começa outra
+static void run_add(BlockRun* run, uint32_t block) {
+    if (run->count > 0 && block == run->start + run->count) {
+        run->count++;
+        return;
+    }
+    free_data_blocks(run->start, run->count);
+    run->start = block;
+    run->count = 1;
+}
+
+int bmap_set(uint32_t inode_num, uint32_t index, uint32_t block) {
+    Inode* inode = &inode_table[inode_num];
+
+    if (index < MAX_DIRECT_POINTERS) {
+        inode->direct_pointers[index] = block;
+        return 0;
+    }
+
+    index -= MAX_DIRECT_POINTERS;
+    if (index >= POINTERS_PER_BLOCK) return -1;
+
+    uint32_t indirect = indirect_block(inode, 1);
+    if (indirect == 0) return -1;
+    uint32_t* pointers = get_block(indirect);
+    if (!pointers) return -1;
+    pointers[index] = block;
+    mark_dirty_meta(indirect);
+    put_block(indirect);
+    return 0;
+}
+
+void inode_truncate(uint32_t inode_num) {
+    Inode* inode = &inode_table[inode_num];
+    BlockRun run = { 0, 0 };
 
     for (int i = 0; i < MAX_DIRECT_POINTERS; i++) {
-        if (current_dir_inode.direct_pointers[i] != 0) {
-            read_block(current_dir_inode.direct_pointers[i], dir_block);
-            for (uint32_t j = 0; j < (BLOCK_SIZE / sizeof(DirectoryEntry)); j++) {
-                if (strcmp(dir_block[j].filename, name) == 0) {
-                    *entry = dir_block[j];
-                    return dir_block[j].inode_number;
-                }
+        if (inode->direct_pointers[i] != 0) {
+            run_add(&run, inode->direct_pointers[i]);
+            inode->direct_pointers[i] = 0;
+        }
+    }
+
+    // Com o bloco indireto corrompido, os blocos apontados por ele vazam
+    // até o próximo 'fsck -r'
+    uint32_t indirect = inode->indirect_pointer;
+    if (indirect != 0) {
+        uint32_t* pointers = get_block(indirect);
+        if (pointers) {
+            for (uint32_t i = 0; i < POINTERS_PER_BLOCK; i++) {
+                if (pointers[i] != 0) run_add(&run, pointers[i]);
+            }
+            put_block(indirect);
+        }
+        run_add(&run, indirect);
+        inode->indirect_pointer = 0;
+    }
+    free_data_blocks(run.start, run.count);
+
+    inode->size = 0;
+    mark_inode_dirty(inode_num);
+}
+
+uint32_t inode_blocks(uint32_t inode_num) {
+    const Inode* inode = &inode_table[inode_num];
+    uint32_t blocks = (inode->size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    return blocks + (inode->indirect_pointer != 0);
+}
+
+int dirent_valid(const DirectoryEntry* entry, uint32_t offset) {
+    return entry->rec_len >= DIRENT_HEADER_SIZE
+        && (entry->rec_len & 3) == 0
+        && offset + entry->rec_len <= BLOCK_SIZE
+        && DIRENT_SIZE(entry->name_len) <= entry->rec_len;
+}
+
+// Preenche uma entrada; rec_len fica a cargo do chamador
+static void dirent_fill(DirectoryEntry* entry, const char* name, uint32_t len,
+                        uint32_t inode_num, uint8_t type) {
+    entry->inode_number = inode_num;
+    entry->name_len = len;
+    entry->type = type;
+    memcpy(entry->name, name, len);
+}
+
+// Procura 'name' no diretório. Se encontrar, devolve a entrada com seu bloco
+// ainda mapeado (o chamador faz o put_block), o número desse bloco e a
+// entrada anterior no mesmo bloco (NULL se for a primeira).
+static DirectoryEntry* dir_find(uint32_t dir_inode_num, const char* name,
+                                uint32_t* block_out, DirectoryEntry** prev_out) {
+    uint32_t len = strlen(name);
+    uint32_t blocks = inode_table[dir_inode_num].size / BLOCK_SIZE;
+
+    for (uint32_t i = 0; i < blocks; i++) {
+        uint32_t block = bmap(dir_inode_num, i, 0);
+        if (block == 0) continue;
+
+        char* data = get_block(block);
+        if (!data) continue;
+        DirectoryEntry* prev = NULL;
+        DirectoryEntry* e;
+        for (uint32_t off = 0; off < BLOCK_SIZE; off += e->rec_len) {
+            e = (DirectoryEntry*)(data + off);
+            if (!dirent_valid(e, off)) break;   // O restante do bloco fica para o fsck
+            if (e->name_len == len && memcmp(e->name, name, len) == 0) {
+                *block_out = block;
+                if (prev_out) *prev_out = prev;
+                return e;
+            }
+            prev = e;
+        }
+        put_block(block);
+    }
+    return NULL;
+}
+
+int dir_lookup(uint32_t dir_inode_num, const char* name) {
+    uint32_t block;
+    DirectoryEntry* e = dir_find(dir_inode_num, name, &block, NULL);
+    if (!e) return -1; // Entrada não encontrada
+
+    int inode_num = e->inode_number;
+    put_block(block);
+    return inode_num;
+}
+
+// Grava a entrada no primeiro espaço livre que a comporte: uma entrada vazia
+// ou a sobra depois do nome de outra entrada. Sem espaço, o diretório ganha
+// um bloco novo. Retorna -1 se o nome for inválido ou o diretório não crescer.
+int dir_add_entry(uint32_t dir_inode_num, const char* name, uint32_t inode_num, uint8_t type) {
+    Inode* dir_inode = &inode_table[dir_inode_num];
+    uint32_t len = strlen(name);
+    if (len == 0 || len > MAX_FILENAME_LEN) return -1;
+    uint32_t need = DIRENT_SIZE(len);
+    uint32_t blocks = dir_inode->size / BLOCK_SIZE;
+
+    for (uint32_t i = 0; i < blocks; i++) {
+        uint32_t block = bmap(dir_inode_num, i, 0);
+        if (block == 0) continue;
+
+        char* data = get_block(block);
+        if (!data) continue;
+        DirectoryEntry* e;
+        for (uint32_t off = 0; off < BLOCK_SIZE; off += e->rec_len) {
+            e = (DirectoryEntry*)(data + off);
+            if (!dirent_valid(e, off)) break;
+
+            uint32_t used = e->name_len ? DIRENT_SIZE(e->name_len) : 0;
+            if (e->rec_len - used < need) continue;
+
+            // Divide a entrada: ela fica com o que usa e a nova, com a sobra
+            DirectoryEntry* slot = e;
+            if (used) {
+                slot = (DirectoryEntry*)(data + off + used);
+                slot->rec_len = e->rec_len - used;
+                e->rec_len = used;
             }
+            dirent_fill(slot, name, len, inode_num, type);
+            mark_dirty_meta(block);
+            put_block(block);
+            return 0;
         }
+        put_block(block);
     }
-    return -1; // Entrada não encontrada
+
+    // Nenhum bloco tem espaço: o diretório cresce um bloco
+    uint32_t block = bmap(dir_inode_num, blocks, 1);
+    mark_inode_dirty(dir_inode_num);
+    if (block == 0) return -1;
+
+    DirectoryEntry* e = get_block_unverified(block);
+    memset(e, 0, BLOCK_SIZE);
+    e->rec_len = BLOCK_SIZE;
+    dirent_fill(e, name, len, inode_num, type);
+    mark_dirty_meta(block);
+    put_block(block);
+
+    dir_inode->size += BLOCK_SIZE;
+    mark_inode_dirty(dir_inode_num);
+    return 0;
+}
+
+// Apaga a entrada, devolvendo seu espaço à entrada anterior do bloco. A
+// primeira entrada de um bloco não tem anterior e só é marcada como vazia.
+int dir_remove_entry(uint32_t dir_inode_num, const char* name) {
+    uint32_t block;
+    DirectoryEntry* prev;
+    DirectoryEntry* e = dir_find(dir_inode_num, name, &block, &prev);
+    if (!e) return -1;
+
+    int inode_num = e->inode_number;
+    if (prev) {
+        prev->rec_len += e->rec_len;
+    } else {
+        e->name_len = 0;
+        e->inode_number = 0;
+    }
+    mark_dirty_meta(block);
+    put_block(block);
+    return inode_num;
+}
+
+// Cria o primeiro bloco de um diretório vazio, com "." e ".."
+int dir_init_block(uint32_t dir_inode_num, uint32_t parent_inode_num) {
+    uint32_t block = bmap(dir_inode_num, 0, 1);
+    if (block == 0) return -1;
+
+    char* data = get_block_unverified(block);
+    memset(data, 0, BLOCK_SIZE);
+    DirectoryEntry* dot = (DirectoryEntry*)data;
+    dot->rec_len = DIRENT_SIZE(1);
+    dirent_fill(dot, ".", 1, dir_inode_num, ATTR_DIRECTORY);
+    DirectoryEntry* dotdot = (DirectoryEntry*)(data + dot->rec_len);
+    dotdot->rec_len = BLOCK_SIZE - dot->rec_len;
+    dirent_fill(dotdot, "..", 2, parent_inode_num, ATTR_DIRECTORY);
+    mark_dirty_meta(block);
+    put_block(block);
+
+    inode_table[dir_inode_num].size = BLOCK_SIZE;
+    mark_inode_dirty(dir_inode_num);
+    return 0;
+}
+
+int dir_foreach(uint32_t dir_inode_num, dir_visit_fn visit, void* arg) {
+    uint32_t blocks = inode_table[dir_inode_num].size / BLOCK_SIZE;
+
+    for (uint32_t i = 0; i < blocks; i++) {
+        uint32_t block = bmap(dir_inode_num, i, 0);
+        if (block == 0) continue;
+
+        char* data = get_block(block);
+        if (!data) return -1;
+        DirectoryEntry* e;
+        for (uint32_t off = 0; off < BLOCK_SIZE; off += e->rec_len) {
+            e = (DirectoryEntry*)(data + off);
+            if (!dirent_valid(e, off)) break;
+            if (e->name_len == 0) continue;
+            int stop = visit(e, arg);
+            if (stop) {
+                put_block(block);
+                return stop;
+            }
+        }
+        put_block(block);
+    }
+    return 0;
+}
+
+int find_entry(const char* name) {
+    PERF_SCOPE(PERF_FIND_ENTRY);
+    INODE_GUARD(fs_ctx->cwd_inode);
+    return dir_lookup(fs_ctx->cwd_inode, name);
+}
+
+// Resolve um nome no diretório atual (NULL é o próprio diretório atual) e
+// devolve o inode já travado, ou -1 se ele não existir. Um filho é travado
+// antes de soltar o diretório atual, como em rm_entry. ".." não é filho: o
+// diretório atual é solto antes de travar o pai, que não pode ser removido
+// enquanto contiver o diretório de uma tarefa.
+int lock_entry(const char* name) {
+    uint32_t cwd = fs_ctx->cwd_inode;
+    inode_lock(cwd);
+    if (!name) return cwd;
+    int found = dir_lookup(cwd, name);
+    if (found == -1 || (uint32_t)found == cwd) {
+        if (found == -1) inode_unlock(cwd);
+        return found;
+    }
+    if (strcmp(name, "..") == 0) {
+        inode_unlock(cwd);
+        inode_lock(found);
+        return found;
+    }
+    inode_lock(found);
+    inode_unlock(cwd);
+    return found;
 }
 
 const char* fs_get_current_path() {
-    return current_path_string;
+    return fs_ctx->cwd_path;
+}
+
+void fs_context_init(FsContext* ctx) {
+    ctx->cwd_inode = sb.root_inode_number;
+    strcpy(ctx->cwd_path, "/");
+}
+
+void fs_set_context(FsContext* ctx) {
+    fs_ctx = ctx;
 }
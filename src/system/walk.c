@@ -0,0 +1,133 @@
+#include "walk.h"
+#include "common.h"
+#include "fs_defs.h"
+#include "kmem.h"
+#include "perf.h"
+#include "task.h"
+
+// Um diretório aberto na pilha do percurso: a posição da próxima entrada e
+// o comprimento do seu caminho no buffer compartilhado
+typedef struct {
+    uint32_t inode_num;
+    uint32_t parent_inode;
+    uint32_t block_index;
+    uint32_t offset;
+    uint32_t path_len;
+} WalkFrame;
+
+// Avança o cursor do diretório até a próxima entrada em uso e a devolve com
+// seu bloco mapeado. Retorna 1 se achou, 0 no fim do diretório e -1 se um
+// bloco estiver corrompido.
+static int next_entry(WalkFrame* f, DirectoryEntry** entry_out, uint32_t* block_out) {
+    uint32_t blocks = inode_table[f->inode_num].size / BLOCK_SIZE;
+
+    for (; f->block_index < blocks; f->block_index++, f->offset = 0) {
+        uint32_t block = bmap(f->inode_num, f->block_index, 0);
+        if (block == 0) continue;
+
+        char* data = get_block(block);
+        if (!data) return -1;
+        while (f->offset < BLOCK_SIZE) {
+            DirectoryEntry* e = (DirectoryEntry*)(data + f->offset);
+            if (!dirent_valid(e, f->offset)) break;
+            f->offset += e->rec_len;
+            if (e->name_len != 0) {
+                *entry_out = e;
+                *block_out = block;
+                return 1;
+            }
+        }
+        put_block(block);
+    }
+    return 0;
+}
+
+// Acrescenta "/nome" ao caminho, se couber; retorna o novo comprimento
+static uint32_t path_append(char* path, uint32_t len, const char* name, uint32_t name_len) {
+    if (len + 1 + name_len >= MAX_PATH_LEN) return len;
+    path[len] = '/';
+    memcpy(path + len + 1, name, name_len);
+    return len + 1 + name_len;
+}
+
+int fs_walk(uint32_t dir_inode, const char* root_path, walk_fn visit, void* arg) {
+    PERF_SCOPE(PERF_FS_WALK);
+
+    // A profundidade é limitada pelo número de diretórios, e portanto de inodes
+    Arena scratch = ARENA_INIT;
+    WalkFrame* stack = arena_alloc(&scratch, NUM_INODES * sizeof(WalkFrame));
+    uint32_t* visited = arena_alloc(&scratch, (NUM_INODES + 31) / 32 * sizeof(uint32_t));
+    char* path = arena_alloc(&scratch, MAX_PATH_LEN);
+    char* name = arena_alloc(&scratch, MAX_FILENAME_LEN + 1);
+    if (!stack || !visited || !path || !name) {
+        arena_release(&scratch);
+        return -2;
+    }
+
+    uint32_t root_len = strlen(root_path);
+    if (root_len >= MAX_PATH_LEN) root_len = MAX_PATH_LEN - 1;
+    memcpy(path, root_path, root_len);
+
+    int result = 0;
+    uint32_t depth = 0;
+    stack[0] = (WalkFrame){ dir_inode, dir_inode, 0, 0, root_len };
+    set_bitmap_bit(visited, dir_inode);
+
+    for (;;) {
+        WalkFrame* f = &stack[depth];
+        DirectoryEntry* e;
+        uint32_t block;
+        int found = next_entry(f, &e, &block);
+        if (found < 0) {
+            result = -1;
+            break;
+        }
+
+        // Fim do diretório: visita pós-ordem e volta ao pai
+        if (found == 0) {
+            if (depth == 0) break;
+            path[f->path_len] = '\0';
+            WalkEntry w = { f->inode_num, f->parent_inode, ATTR_DIRECTORY, depth, NULL, path };
+            result = visit(&w, WALK_POST, arg);
+            inode_unlock(f->inode_num);
+            depth--;
+            if (result < 0) break;
+            continue;
+        }
+
+        // Copia a entrada antes de liberar o bloco
+        uint32_t n = e->inode_number;
+        uint32_t name_len = e->name_len;
+        memcpy(name, e->name, name_len);
+        name[name_len] = '\0';
+        put_block(block);
+        task_yield();
+
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+        if (n >= NUM_INODES || !((inode_bitmap[n / 32] >> (n % 32)) & 1)
+            || ((visited[n / 32] >> (n % 32)) & 1)) {
+            continue;
+        }
+        uint8_t type = inode_table[n].type;
+        if (type != ATTR_FILE && type != ATTR_DIRECTORY) continue;
+        set_bitmap_bit(visited, n);
+
+        uint32_t len = path_append(path, f->path_len, name, name_len);
+        path[len] = '\0';
+        WalkEntry w = { n, f->inode_num, type, depth + 1, name, path };
+        result = visit(&w, WALK_PRE, arg);
+        if (result < 0) break;
+
+        if (type == ATTR_DIRECTORY && result != WALK_SKIP) {
+            inode_lock(n);
+            depth++;
+            stack[depth] = (WalkFrame){ n, f->inode_num, 0, 0, len };
+        }
+        result = 0;
+    }
+
+    // Interrompido: libera os diretórios que ficaram abertos
+    while (depth > 0) inode_unlock(stack[depth--].inode_num);
+    arena_release(&scratch);
+    return result;
+}
@@ -2,25 +2,63 @@
 
 .global _start
 
+.arch_extension virt
+
 _start:
+    // O firmware entrega o núcleo em modo HYP; o kernel roda em SVC
+    mrs r0, cpsr
+    and r0, r0, #0x1F
+    cmp r0, #0x1A
+    bne in_svc
+
+    // Libera o contador e o timer físicos para PL1 (CNTHCTL) e zera o
+    // deslocamento do contador virtual (CNTVOFF)
+    mrc p15, 4, r0, c14, c1, 0
+    orr r0, r0, #3
+    mcr p15, 4, r0, c14, c1, 0
+    mov r0, #0
+    mov r1, #0
+    mcrr p15, 4, r0, r1, c14
+
+    // HYP -> SVC, com IRQ e FIQ mascaradas
+    mov r0, #0xD3
+    msr spsr_hyp, r0
+    ldr r0, =in_svc
+    msr elr_hyp, r0
+    eret
+
+in_svc:
+    // Pilha do modo IRQ, usada pelo profiler (vectors.s)
+    cps #0x12
+    ldr sp, =_irq_stack_top
+    cps #0x13
+
     // Configura o ponteiro de pilha (Stack Pointer)
     ldr sp, =_stack_top
 
-    // Zera a seção .bss
+    // Instante de entrada (System Timer, em us), repassado a main
+    ldr r4, =0x3F003004
+    ldr r4, [r4]
+
+    // Zera a seção .bss, 16 bytes por instrução (alinhada em linker.ld).
+    // O disco em RAM fica em .noinit e não é zerado.
     ldr r0, =__bss_start
     ldr r1, =__bss_end
     mov r2, #0
+    mov r3, #0
+    mov r5, #0
+    mov r6, #0
 clear_bss:
     cmp r0, r1
-    bge call_main
-    str r2, [r0], #4
-    b clear_bss
+    stmlo r0!, {r2, r3, r5, r6}
+    blo clear_bss
 
 call_main:
     // Chama a função principal em C (bl = branch with link)
+    mov r0, r4
     bl main
 
 // Se main retornar, entra em loop infinito
 hang:
     wfe
-    b hang
\ No newline at end of file
+    b hang
@@ -0,0 +1,91 @@
+.section ".text.boot"
+
+.global _start
+
+_start:
+    // Todos os quatro núcleos começam aqui; só o núcleo 0 segue adiante
+    mrs x0, mpidr_el1
+    and x0, x0, #3
+    cbnz x0, park
+
+    // O firmware entrega o núcleo em EL2 (ou EL3, no QEMU sem firmware)
+    mrs x0, CurrentEL
+    lsr x0, x0, #2
+    cmp x0, #3
+    b.ne from_el2
+
+    // EL3 -> EL2: EL2 em AArch64 (RW, bit 10), mundo não seguro (NS, bit 0)
+    mov x0, #(1 << 10) | (1 << 0)
+    msr scr_el3, x0
+    mov x0, #0x3c9              // EL2h, com DAIF mascarados
+    msr spsr_el3, x0
+    adr x0, from_el2
+    msr elr_el3, x0
+    eret
+
+from_el2:
+    mrs x0, CurrentEL
+    lsr x0, x0, #2
+    cmp x0, #2
+    b.ne in_el1
+
+    // EL1 em AArch64 (HCR_EL2.RW) e sem armadilhas de FP/SIMD em EL2
+    mov x0, #(1 << 31)
+    msr hcr_el2, x0
+    mov x0, #0x33ff
+    msr cptr_el2, x0
+    // Libera o contador e o timer físicos para EL1
+    mrs x0, cnthctl_el2
+    orr x0, x0, #3
+    msr cnthctl_el2, x0
+    msr cntvoff_el2, xzr
+
+    // EL2 -> EL1h, com DAIF mascarados
+    mov x0, #0x3c5
+    msr spsr_el2, x0
+    adr x0, in_el1
+    msr elr_el2, x0
+    eret
+
+in_el1:
+    // SCTLR_EL1 só com os bits reservados em 1: MMU, caches e verificação
+    // de alinhamento desligadas, little-endian. Toda a RAM é memória Device,
+    // onde um acesso desalinhado falha de qualquer forma (-mstrict-align).
+    ldr x0, =0x30d00800
+    msr sctlr_el1, x0
+    isb
+
+    // Habilita FP/SIMD em EL1 (CPACR_EL1.FPEN = 0b11); o GCC usa os
+    // registradores Q para cópias e varargs
+    mov x0, #(3 << 20)
+    msr cpacr_el1, x0
+    isb
+
+    // Configura o ponteiro de pilha (Stack Pointer)
+    ldr x0, =_stack_top
+    mov sp, x0
+
+    // Instante de entrada (System Timer, em us), repassado a main
+    ldr x0, =0x3F003004
+    ldr w19, [x0]
+
+    // Zera a seção .bss, 16 bytes por instrução (alinhada em linker64.ld).
+    // O disco em RAM fica em .noinit e não é zerado.
+    ldr x0, =__bss_start
+    ldr x1, =__bss_end
+clear_bss:
+    cmp x0, x1
+    b.hs call_main
+    stp xzr, xzr, [x0], #16
+    b clear_bss
+
+call_main:
+    // Chama a função principal em C (bl = branch with link)
+    mov w0, w19
+    bl main
+
+// Se main retornar, ou nos núcleos secundários, entra em loop infinito
+park:
+hang:
+    wfe
+    b hang
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Compares `bench` results captured from different SimpleFS builds.
+
+Each input is a serial capture containing one or more runs of the `bench`
+shell command (lines starting with "BENCH"). When a capture holds several
+runs, the median of each metric is used. The first capture is the baseline;
+every other column shows its value and the change relative to it. Typical
+use, comparing the 32-bit and 64-bit images on the same board:
+
+    make clean && make && <boot, run "bench" 3 times>     -> armv7.log
+    make clean && make ARCH=aarch64 && <same>             -> aarch64.log
+    tools/benchcmp.py armv7.log aarch64.log
+
+The `flash bench` lines (flash_inplace, flash_log) are compared the same
+way, adding the write amplification (wa_x100) and the modeled device time.
+"""
+
+import argparse
+import statistics
+import sys
+
+# Lower is better for times, higher for throughput
+METRICS = [("ns_op", "lower"), ("kBps", "higher"), ("wa_x100", "lower"), ("dev_us", "lower")]
+
+
+def parse_capture(path):
+    """Returns (label, {step: {metric: [values]}})."""
+    label = path
+    results = {}
+    with open(path, "rb") as f:
+        text = f.read().decode("ascii", errors="replace")
+    for line in text.splitlines():
+        line = line.strip()
+        if not line.startswith("BENCH "):
+            continue
+        fields = line.split()
+        step = fields[1]
+        values = dict(f.split("=", 1) for f in fields[2:] if "=" in f)
+        if step == "begin":
+            label = "%s (%s)" % (path, values.get("arch", "?"))
+        elif step == "error":
+            print("warning: %s: run failed at step %s" % (path, values.get("step")),
+                  file=sys.stderr)
+        elif step != "end":
+            for metric, _ in METRICS:
+                if metric in values:
+                    results.setdefault(step, {}).setdefault(metric, []).append(int(values[metric]))
+    return label, results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("captures", nargs="+", help="serial captures with BENCH lines")
+    args = parser.parse_args()
+
+    runs = [parse_capture(p) for p in args.captures]
+    if not any(r for _, r in runs):
+        sys.exit("error: no BENCH lines found")
+
+    base_label, base = runs[0]
+    print("baseline: %s" % base_label)
+    for label, _ in runs[1:]:
+        print("compared: %s" % label)
+    print()
+
+    header = "%-12s %-6s %12s" % ("step", "metric", "baseline")
+    for i in range(1, len(runs)):
+        header += " %12s %10s" % ("run %d" % i, "change")
+    print(header)
+
+    steps = list(base)
+    for _, results in runs[1:]:
+        steps += [s for s in results if s not in steps]
+    for step in steps:
+        for metric, better in METRICS:
+            base_values = base.get(step, {}).get(metric)
+            if not base_values and not any(r.get(step, {}).get(metric) for _, r in runs[1:]):
+                continue
+            base_value = statistics.median(base_values) if base_values else None
+            row = "%-12s %-6s %12s" % (step, metric, "-" if base_value is None else "%d" % base_value)
+            for _, results in runs[1:]:
+                values = results.get(step, {}).get(metric)
+                if not values:
+                    row += " %12s %10s" % ("-", "")
+                    continue
+                value = statistics.median(values)
+                change = ""
+                if base_value:
+                    pct = 100.0 * (value - base_value) / base_value
+                    faster = pct < 0 if better == "lower" else pct > 0
+                    change = "%+.1f%%%s" % (pct, "" if pct == 0 else (" +" if faster else " -"))
+                row += " %12d %10s" % (value, change)
+            print(row)
+    print("\n('+' marks an improvement over the baseline, '-' a regression)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,217 @@
+#!/usr/bin/env python3
+"""Replays a SimpleFS block trace against simulated block caches.
+
+The trace is the binary stream printed by the shell command `blktrace dump`
+(build with `make BLKTRACE=1`). Capture the serial output to a file, e.g.
+`screen -L` or `qemu ... -serial file:trace.log`; everything before the
+"BTRC" header is ignored.
+
+For each cache policy (LRU, ARC) and size, the tool reports the hit rate and
+the projected number of I/Os that would reach the backing device, with
+write-back (dirty blocks written on eviction and at the end) or
+write-through caching.
+
+Usage:
+    tools/blkreplay.py trace.log [--sizes 8,16,32,64] [--policy lru,arc]
+                       [--layout identity|meta-pinned|cluster:N]
+                       [--write-through]
+"""
+
+import argparse
+import struct
+import sys
+from collections import Counter, OrderedDict
+
+MAGIC = b"BTRC"
+VERSION = 1
+
+# Mirrors enum perf_op in include/perf.h
+OP_NAMES = [
+    "fs_format", "fs_mount", "fs_stat", "fs_fsck", "find_entry", "fs_ls",
+    "fs_mkdir", "fs_touch", "fs_cd", "fs_cat", "fs_write", "fs_rm",
+    "read_block", "write_block", "readahead", "block_csum", "fs_walk",
+    "fs_read",
+]
+
+
+def op_name(op):
+    return OP_NAMES[op] if op < len(OP_NAMES) else "(none)"
+
+
+def parse_trace(data):
+    start = data.find(MAGIC)
+    if start < 0:
+        sys.exit("error: no BTRC header found in input")
+    magic, version, count, data_start, total = struct.unpack_from("<5I", data, start)
+    if version != VERSION:
+        sys.exit("error: unsupported trace version %d" % version)
+    body = start + 20
+    if len(data) < body + 8 * count:
+        sys.exit("error: trace truncated (%d of %d records)" % ((len(data) - body) // 8, count))
+    records = []
+    for i in range(count):
+        ts, info = struct.unpack_from("<II", data, body + 8 * i)
+        records.append((ts, info & 0xFFFFFF, (info >> 24) & 0x7F, info >> 31))
+    return data_start, total, records
+
+
+class LRUCache:
+    def __init__(self, size):
+        self.size = size
+        self.blocks = OrderedDict()  # block -> dirty
+
+    def access(self, block, write):
+        """Returns (hit, evicted_dirty_count)."""
+        if block in self.blocks:
+            self.blocks.move_to_end(block)
+            self.blocks[block] |= write
+            return True, 0
+        evicted = 0
+        if len(self.blocks) >= self.size:
+            _, dirty = self.blocks.popitem(last=False)
+            evicted = int(dirty)
+        self.blocks[block] = bool(write)
+        return False, evicted
+
+    def dirty_blocks(self):
+        return sum(self.blocks.values())
+
+
+class ARCCache:
+    """Adaptive Replacement Cache (Megiddo & Modha, FAST '03)."""
+
+    def __init__(self, size):
+        self.c = size
+        self.p = 0
+        self.t1, self.t2 = OrderedDict(), OrderedDict()  # block -> dirty
+        self.b1, self.b2 = OrderedDict(), OrderedDict()  # ghost lists
+
+    def _replace(self, in_b2):
+        if self.t1 and (len(self.t1) > self.p or (in_b2 and len(self.t1) == self.p)):
+            block, dirty = self.t1.popitem(last=False)
+            self.b1[block] = None
+        else:
+            block, dirty = self.t2.popitem(last=False)
+            self.b2[block] = None
+        return int(dirty)
+
+    def access(self, block, write):
+        for t in (self.t1, self.t2):
+            if block in t:
+                dirty = t.pop(block) or bool(write)
+                self.t2[block] = dirty
+                return True, 0
+
+        evicted = 0
+        if block in self.b1:
+            self.p = min(self.c, self.p + max(len(self.b2) // max(len(self.b1), 1), 1))
+            evicted = self._replace(False)
+            del self.b1[block]
+            self.t2[block] = bool(write)
+            return False, evicted
+        if block in self.b2:
+            self.p = max(0, self.p - max(len(self.b1) // max(len(self.b2), 1), 1))
+            evicted = self._replace(True)
+            del self.b2[block]
+            self.t2[block] = bool(write)
+            return False, evicted
+
+        l1 = len(self.t1) + len(self.b1)
+        total = l1 + len(self.t2) + len(self.b2)
+        if l1 == self.c:
+            if len(self.t1) < self.c:
+                self.b1.popitem(last=False)
+                evicted = self._replace(False)
+            else:
+                _, dirty = self.t1.popitem(last=False)
+                evicted = int(dirty)
+        elif total >= self.c:
+            if total == 2 * self.c:
+                self.b2.popitem(last=False)
+            evicted = self._replace(False)
+        self.t1[block] = bool(write)
+        return False, evicted
+
+    def dirty_blocks(self):
+        return sum(self.t1.values()) + sum(self.t2.values())
+
+
+POLICIES = {"lru": LRUCache, "arc": ARCCache}
+
+
+def make_layout(spec, data_start):
+    """Returns a function mapping a block to its cache key, or None to bypass the cache."""
+    if spec == "identity":
+        return lambda b: b
+    if spec == "meta-pinned":
+        # Metadata blocks (superblock, bitmaps, inode table) stay resident
+        return lambda b: None if b < data_start else b
+    if spec.startswith("cluster:"):
+        n = int(spec.split(":", 1)[1])
+        return lambda b: b // n
+    sys.exit("error: unknown layout '%s'" % spec)
+
+
+def simulate(records, policy, size, layout, write_through):
+    cache = POLICIES[policy](size)
+    hits = dev_reads = dev_writes = 0
+    for _, block, _, write in records:
+        key = layout(block)
+        if key is None:
+            hits += 1
+            dev_writes += write and write_through
+            continue
+        hit, evicted = cache.access(key, write and not write_through)
+        hits += hit
+        if not hit and not write:
+            dev_reads += 1
+        dev_writes += evicted + (write and write_through)
+    if not write_through:
+        dev_writes += cache.dirty_blocks()
+    return hits, dev_reads, dev_writes
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("trace", help="captured serial output containing a BTRC dump")
+    parser.add_argument("--sizes", default="4,8,16,32,64,128", help="cache sizes in blocks")
+    parser.add_argument("--policy", default="lru,arc", help="comma-separated: lru, arc")
+    parser.add_argument("--layout", default="identity",
+                        help="identity, meta-pinned or cluster:N (N blocks per cache line)")
+    parser.add_argument("--write-through", action="store_true",
+                        help="write every block to the device instead of on eviction")
+    args = parser.parse_args()
+
+    with open(args.trace, "rb") as f:
+        data_start, total_blocks, records = parse_trace(f.read())
+    if not records:
+        sys.exit("trace is empty")
+
+    reads = sum(1 for r in records if not r[3])
+    writes = len(records) - reads
+    print("trace: %d accesses (%d reads, %d writes), %d distinct blocks, %.3f s"
+          % (len(records), reads, writes, len({r[1] for r in records}),
+             ((records[-1][0] - records[0][0]) & 0xFFFFFFFF) / 1e6))
+    print("volume: %d blocks, data area starts at block %d" % (total_blocks, data_start))
+    by_op = Counter((op_name(r[2]), r[3]) for r in records)
+    for name in sorted({k[0] for k in by_op}):
+        print("  %-12s %7d reads %7d writes" % (name, by_op[(name, 0)], by_op[(name, 1)]))
+
+    layout = make_layout(args.layout, data_start)
+    mode = "write-through" if args.write_through else "write-back"
+    print("\nuncached device I/O: %d reads, %d writes" % (reads, writes))
+    print("%-6s %6s %8s %10s %10s %10s   (%s, layout %s)"
+          % ("policy", "size", "hit%", "dev reads", "dev writes", "total I/O", mode, args.layout))
+    for policy in args.policy.split(","):
+        if policy not in POLICIES:
+            sys.exit("error: unknown policy '%s'" % policy)
+        for size in (int(s) for s in args.sizes.split(",")):
+            hits, dev_reads, dev_writes = simulate(records, policy, size, layout,
+                                                   args.write_through)
+            print("%-6s %6d %7.2f%% %10d %10d %10d"
+                  % (policy, size, 100.0 * hits / len(records), dev_reads, dev_writes,
+                     dev_reads + dev_writes))
+
+
+if __name__ == "__main__":
+    main()
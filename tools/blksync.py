@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Keeps a host-side mirror image of a SimpleFS disk in sync over serial.
+
+`export` on the device streams the blocks changed since its last checkpoint
+(`export -a` streams every block in use). Capture the serial output to a
+file and apply it to the mirror; everything outside the SFSX...SFSE frames
+is ignored, so a capture may hold several exports, applied in order:
+
+    tools/blksync.py apply capture.log mirror.img
+
+The mirror is a raw image of the RAM disk. Its checkpoint is kept next to
+it in mirror.img.ckpt; an incremental export is only applied on top of the
+checkpoint it was taken from.
+
+To restore the device, run `import` in the shell and send a full stream
+built from the mirror (the serial port must be in raw mode):
+
+    tools/blksync.py pack mirror.img > /dev/ttyUSB0
+"""
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b"SFSX"
+END = b"SFSE"
+VERSION = 1
+HEADER = struct.Struct("<7I")
+
+
+def record_crc(block, data):
+    return zlib.crc32(data, zlib.crc32(struct.pack("<I", block))) & 0xFFFFFFFF
+
+
+def parse_streams(data):
+    """Yields (block_size, total, base, checkpoint, [(block, bytes)]) per frame."""
+    pos = data.find(MAGIC)
+    while pos >= 0:
+        if len(data) < pos + HEADER.size:
+            sys.exit("error: stream header truncated at offset %d" % pos)
+        _, version, block_size, total, base, ckpt, count = HEADER.unpack_from(data, pos)
+        if version != VERSION:
+            sys.exit("error: unsupported stream version %d" % version)
+        body = pos + HEADER.size
+        end = body + count * (block_size + 8)
+        if len(data) < end + 4:
+            sys.exit("error: stream for checkpoint %d truncated" % ckpt)
+        if data[end:end + 4] != END:
+            sys.exit("error: stream for checkpoint %d has no end marker" % ckpt)
+        blocks = []
+        for i in range(count):
+            off = body + i * (block_size + 8)
+            (block,) = struct.unpack_from("<I", data, off)
+            payload = data[off + 4:off + 4 + block_size]
+            (crc,) = struct.unpack_from("<I", data, off + 4 + block_size)
+            if block >= total or crc != record_crc(block, payload):
+                sys.exit("error: bad record %d in stream for checkpoint %d" % (i, ckpt))
+            blocks.append((block, payload))
+        yield block_size, total, base, ckpt, blocks
+        pos = data.find(MAGIC, end + 4)
+
+
+def read_checkpoint(image):
+    try:
+        with open(image + ".ckpt") as f:
+            return int(f.read())
+    except FileNotFoundError:
+        return None
+
+
+def apply(args):
+    with open(args.capture, "rb") as f:
+        streams = list(parse_streams(f.read()))
+    if not streams:
+        sys.exit("error: no SFSX stream found in input")
+
+    current = read_checkpoint(args.image)
+    for block_size, total, base, ckpt, blocks in streams:
+        if base == 0:
+            # Full image: start from zeros, free blocks are not sent
+            with open(args.image, "wb") as f:
+                f.truncate(block_size * total)
+        elif base != current or not os.path.exists(args.image):
+            sys.exit("error: stream goes from checkpoint %d to %d, mirror is at %s; "
+                     "run 'export -a'" % (base, ckpt, current))
+        with open(args.image, "r+b") as f:
+            for block, payload in blocks:
+                f.seek(block * block_size)
+                f.write(payload)
+        current = ckpt
+        with open(args.image + ".ckpt", "w") as f:
+            f.write("%d\n" % current)
+        print("checkpoint %d: %d blocks (%s, %d KiB)"
+              % (ckpt, len(blocks), "full" if base == 0 else "incremental",
+                 len(blocks) * block_size // 1024))
+
+
+def pack(args):
+    with open(args.image, "rb") as f:
+        image = f.read()
+    if len(image) % args.block_size:
+        sys.exit("error: image size is not a multiple of %d" % args.block_size)
+    total = len(image) // args.block_size
+    ckpt = read_checkpoint(args.image) or 1
+
+    # A full stream: the device zeroes every block that is not sent
+    zero = bytes(args.block_size)
+    records = []
+    for block in range(total):
+        payload = image[block * args.block_size:(block + 1) * args.block_size]
+        if payload != zero:
+            records.append(struct.pack("<I", block) + payload
+                           + struct.pack("<I", record_crc(block, payload)))
+    out = sys.stdout.buffer
+    out.write(HEADER.pack(struct.unpack("<I", MAGIC)[0], VERSION, args.block_size,
+                          total, 0, ckpt, len(records)))
+    out.write(b"".join(records))
+    out.write(END)
+    out.flush()
+    print("packed %d of %d blocks, checkpoint %d" % (len(records), total, ckpt),
+          file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("apply", help="apply captured export streams to a mirror image")
+    p.add_argument("capture", help="captured serial output containing SFSX streams")
+    p.add_argument("image", help="mirror image (created by a full stream)")
+    p.set_defaults(func=apply)
+    p = sub.add_parser("pack", help="write a full stream of a mirror image to stdout")
+    p.add_argument("image", help="mirror image")
+    p.add_argument("--block-size", type=int, default=512)
+    p.set_defaults(func=pack)
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Symbolizes SimpleFS profiler samples into a flat profile and folded stacks.
+
+The samples are the binary stream printed by the shell command `prof dump`
+(build with `make PROF=1`). Capture the serial output to a file, e.g.
+`screen -L` or `qemu ... -serial file:prof.log`; everything before the
+"PROF" header is ignored. Start and stop the profiler on the same line as
+the workload, so the idle loop does not dominate the profile:
+
+    prof start 5000; ls -R /; du /; prof stop
+    prof dump
+
+Addresses are resolved against the ELF of the same build (build/kernel.elf,
+or build/aarch64/kernel.elf for ARCH=aarch64) with `nm`.
+
+Each sample holds the interrupted PC and the return register (lr/x30) at
+that moment. The PC gives the flat profile. The return register names the
+caller only when the interrupted function is not a leaf and has not yet
+reused it, so the folded output (caller;function count, for flamegraph.pl
+or speedscope) is a hint: a "caller" equal to the function itself or
+outside any symbol is dropped and the sample is folded as a single frame.
+
+Usage:
+    tools/profsym.py prof.log [--elf build/kernel.elf] [--nm arm-none-eabi-nm]
+                     [--top 30] [--folded out.folded]
+"""
+
+import argparse
+import bisect
+import shutil
+import struct
+import subprocess
+import sys
+from collections import Counter
+
+MAGIC = b"PROF"
+VERSION = 1
+
+NM_BY_BITS = {32: "arm-none-eabi-nm", 64: "aarch64-none-elf-nm"}
+
+
+def parse_samples(data):
+    start = data.find(MAGIC)
+    if start < 0:
+        sys.exit("error: no PROF header found in input")
+    magic, version, count, hz, lost, bits = struct.unpack_from("<6I", data, start)
+    if version != VERSION:
+        sys.exit("error: unsupported profile version %d" % version)
+    body = start + 24
+    if len(data) < body + 8 * count:
+        sys.exit("error: profile truncated (%d of %d samples)" % ((len(data) - body) // 8, count))
+    samples = [struct.unpack_from("<II", data, body + 8 * i) for i in range(count)]
+    return hz, lost, bits, samples
+
+
+def load_symbols(elf, nm):
+    """Returns sorted (addresses, names) for the text symbols of 'elf'."""
+    try:
+        out = subprocess.run([nm, "-n", "-S", "--defined-only", elf], check=True,
+                             capture_output=True, text=True).stdout
+    except (OSError, subprocess.CalledProcessError) as e:
+        sys.exit("error: %s failed: %s" % (nm, e))
+    addrs, ends, names = [], [], []
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) == 4:
+            addr, size, kind, name = fields
+        elif len(fields) == 3:
+            addr, kind, name = fields
+            size = "0"
+        else:
+            continue
+        # Skips ARM mapping symbols ($a, $d, $x) and non-text symbols
+        if kind not in "tT" or name.startswith("$"):
+            continue
+        addrs.append(int(addr, 16))
+        ends.append(int(addr, 16) + int(size, 16))
+        names.append(name)
+    if not addrs:
+        sys.exit("error: no text symbols in %s" % elf)
+    return addrs, ends, names
+
+
+def resolve(symbols, addr):
+    addrs, ends, names = symbols
+    i = bisect.bisect_right(addrs, addr) - 1
+    if i < 0:
+        return None
+    # Assembly symbols have no size; accept them up to the next symbol
+    if ends[i] > addrs[i] and addr >= ends[i]:
+        return None
+    return names[i]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("capture", help="serial capture containing a 'prof dump'")
+    parser.add_argument("--elf", help="kernel ELF (default: by address width)")
+    parser.add_argument("--nm", help="nm to use (default: by address width)")
+    parser.add_argument("--top", type=int, default=30, help="rows in the flat profile")
+    parser.add_argument("--folded", help="write folded stacks to this file")
+    args = parser.parse_args()
+
+    with open(args.capture, "rb") as f:
+        hz, lost, bits, samples = parse_samples(f.read())
+    if not samples:
+        sys.exit("error: the capture holds no samples")
+
+    elf = args.elf or ("build/aarch64/kernel.elf" if bits == 64 else "build/kernel.elf")
+    nm = args.nm or NM_BY_BITS.get(bits, "nm")
+    if not shutil.which(nm) and shutil.which("nm"):
+        nm = "nm"
+    symbols = load_symbols(elf, nm)
+
+    flat = Counter()
+    folded = Counter()
+    with_caller = 0
+    for pc, lr in samples:
+        func = resolve(symbols, pc) or "0x%x" % pc
+        flat[func] += 1
+        caller = resolve(symbols, lr)
+        if caller and caller != func:
+            folded["%s;%s" % (caller, func)] += 1
+            with_caller += 1
+        else:
+            folded[func] += 1
+
+    total = len(samples)
+    print("%d samples at %d Hz (%.2f s), %d lost, %d-bit kernel (%s)"
+          % (total, hz, total / hz if hz else 0, lost, bits, elf))
+    print("%d samples (%.1f%%) attributed a caller from the return register\n"
+          % (with_caller, 100.0 * with_caller / total))
+    print("%8s %7s %7s  %s" % ("samples", "self%", "cum%", "function"))
+    cum = 0
+    for func, n in flat.most_common(args.top):
+        cum += n
+        print("%8d %6.1f%% %6.1f%%  %s" % (n, 100.0 * n / total, 100.0 * cum / total, func))
+
+    if args.folded:
+        with open(args.folded, "w") as f:
+            for stack, n in sorted(folded.items()):
+                f.write("%s %d\n" % (stack, n))
+        print("\nfolded stacks written to %s" % args.folded)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,47 @@
+/*
+ * Substitutos, para um build no host, do que o núcleo do sistema de
+ * arquivos usa do kernel: o console é descartado, o relógio vem do
+ * CLOCK_MONOTONIC e ceder o processador é ceder a thread.
+ */
+#include "uart.h"
+#include "timer.h"
+#include "task.h"
+#include "mailbox.h"
+#include <sched.h>
+#include <time.h>
+
+void uart_putc(unsigned char c) { (void)c; }
+void uart_puts(const char* s) { (void)s; }
+void uart_write(const char* s, uint32_t len) { (void)s; (void)len; }
+void uart_write_raw(const void* data, uint32_t len) { (void)data; (void)len; }
+void uart_puts_right_aligned(int num, int width) { (void)num; (void)width; }
+void uart_puts_aligned(const char* text, int num1, int num2, const char* suffix) {
+    (void)text; (void)num1; (void)num2; (void)suffix;
+}
+void uart_puts_ratio(const char* text, uint32_t num, uint32_t den) {
+    (void)text; (void)num; (void)den;
+}
+int uart_set_muted(int muted) { (void)muted; return 1; }
+
+// Sem entrada: o import (blksync) espera o magic para sempre; o stress não o usa
+unsigned char uart_getc() { return 0; }
+int uart_has_input() { return 0; }
+
+uint32_t timer_now_us() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t)(t.tv_sec * 1000000 + t.tv_nsec / 1000);
+}
+
+// Um spinlock disputado cede a thread, como cederia a tarefa no alvo
+void task_yield() {
+    sched_yield();
+}
+
+// As threads não se registram: cada uma só apaga o que está no seu diretório
+int task_uses_dir(uint32_t inode_num) {
+    (void)inode_num;
+    return 0;
+}
+
+void mbox_stat() {}
@@ -0,0 +1,85 @@
+/*
+ * Teste de estresse do núcleo do sistema de arquivos no host (make stress).
+ *
+ * Para cada número de threads pedido, formata o disco e roda as threads ao
+ * mesmo tempo, cada uma com o seu contexto (diretório atual) em um
+ * diretório próprio: cria, anexa e remove arquivos, disputando os bitmaps,
+ * a tabela de inodes e o diretório raiz. Ao fim de cada rodada, o fsck
+ * precisa encontrar zero problemas. Mostra a vazão e o ganho sobre a
+ * primeira rodada (make stress começa com uma thread); o ganho só passa de
+ * 1 com mais de um núcleo no host.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "sfs.h"
+#include "kmem.h"
+
+#define STRESS_OPS        20000     // Operações por thread
+#define STRESS_FILES      8         // Arquivos por diretório
+#define STRESS_MAX_THREADS 64
+#define STRESS_HEAP_SIZE  (16 * 1024 * 1024)
+
+static char heap[STRESS_HEAP_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+static void* worker(void* arg) {
+    long id = (long)arg;
+    FsContext ctx;
+    fs_context_init(&ctx);
+    fs_set_context(&ctx);
+
+    char name[16];
+    snprintf(name, sizeof(name), "t%ld", id);
+    fs_mkdir(name);
+    fs_cd(name);
+    // Escrita e remoção alternadas: a cada 3 operações sobre um arquivo, uma remove
+    for (int i = 0; i < STRESS_OPS; i++) {
+        snprintf(name, sizeof(name), "f%d", i % STRESS_FILES);
+        if (i % 3 == 2) {
+            fs_rm(name);
+        } else {
+            fs_write(name, "0123456789abcdef0123456789abcdef");
+        }
+    }
+    return NULL;
+}
+
+static double now_s() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    kmem_init((uintptr_t)heap, (uintptr_t)heap + sizeof(heap));
+    if (argc < 2) {
+        fprintf(stderr, "uso: %s <threads>...\n", argv[0]);
+        return 2;
+    }
+
+    double base = 0;
+    int failed = 0;
+    printf("threads  ops/s      ganho  fsck\n");
+    for (int a = 1; a < argc; a++) {
+        long n = atol(argv[a]);
+        if (n < 1 || n > STRESS_MAX_THREADS) {
+            fprintf(stderr, "numero de threads invalido: %s\n", argv[a]);
+            return 2;
+        }
+        fs_format();
+        fs_mount();
+
+        pthread_t threads[STRESS_MAX_THREADS];
+        double start = now_s();
+        for (long i = 0; i < n; i++) pthread_create(&threads[i], NULL, worker, (void*)i);
+        for (long i = 0; i < n; i++) pthread_join(threads[i], NULL);
+        double ops = (double)n * STRESS_OPS / (now_s() - start);
+
+        int problems = fs_fsck(0);
+        if (problems != 0) failed = 1;
+        if (base == 0) base = ops;
+        printf("%7ld  %9.0f  %5.2fx  %d\n", n, ops, ops / base, problems);
+    }
+    return failed;
+}
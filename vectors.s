@@ -0,0 +1,32 @@
+.section ".text"
+
+// Tabela de exceções (VBAR, alinhada a 32 bytes). Só a IRQ é tratada, pelo
+// profiler; as demais param o núcleo.
+.balign 32
+.global exception_vectors
+exception_vectors:
+    b hang_exception    // Reset
+    b hang_exception    // Instrução indefinida
+    b hang_exception    // SVC
+    b hang_exception    // Prefetch abort
+    b hang_exception    // Data abort
+    b hang_exception    // (não usado)
+    b irq_entry         // IRQ
+    b hang_exception    // FIQ
+
+hang_exception:
+    wfe
+    b hang_exception
+
+// IRQ: roda no modo IRQ, com a pilha própria (_irq_stack_top). Repassa a
+// prof_irq o PC interrompido e o lr do modo SVC, onde o kernel roda.
+irq_entry:
+    sub lr, lr, #4
+    push {r0-r3, r12, lr}
+    mov r0, lr
+    cps #0x13           // SVC, com as IRQs ainda mascaradas, para ler seu lr
+    mov r1, lr
+    cps #0x12
+    bl prof_irq
+    pop {r0-r3, r12, lr}
+    movs pc, lr         // Retorna restaurando o CPSR (SPSR_irq)
@@ -0,0 +1,57 @@
+.section ".text"
+
+// Tabela de exceções do EL1 (VBAR_EL1, alinhada a 2 KB): 16 entradas de
+// 128 bytes. Só a IRQ no próprio EL1 (com SP_EL1) é tratada, pelo
+// profiler; as demais param o núcleo.
+.balign 2048
+.global exception_vectors
+exception_vectors:
+    .rept 5
+    .balign 0x80
+    b hang_exception
+    .endr
+    .balign 0x80        // 0x280: IRQ, EL atual com SP_ELx
+    b irq_entry
+    .rept 10
+    .balign 0x80
+    b hang_exception
+    .endr
+
+hang_exception:
+    wfe
+    b hang_exception
+
+// Salva os registradores que a chamada pode alterar (x0-x18, x29 e x30) e
+// repassa a prof_irq o PC interrompido (ELR_EL1) e o x30 da interrupção.
+// prof_irq só usa registradores inteiros.
+irq_entry:
+    sub sp, sp, #176
+    stp x0, x1, [sp, #0]
+    stp x2, x3, [sp, #16]
+    stp x4, x5, [sp, #32]
+    stp x6, x7, [sp, #48]
+    stp x8, x9, [sp, #64]
+    stp x10, x11, [sp, #80]
+    stp x12, x13, [sp, #96]
+    stp x14, x15, [sp, #112]
+    stp x16, x17, [sp, #128]
+    stp x18, x29, [sp, #144]
+    str x30, [sp, #160]
+
+    mrs x0, elr_el1
+    mov x1, x30
+    bl prof_irq
+
+    ldp x0, x1, [sp, #0]
+    ldp x2, x3, [sp, #16]
+    ldp x4, x5, [sp, #32]
+    ldp x6, x7, [sp, #48]
+    ldp x8, x9, [sp, #64]
+    ldp x10, x11, [sp, #80]
+    ldp x12, x13, [sp, #96]
+    ldp x14, x15, [sp, #112]
+    ldp x16, x17, [sp, #128]
+    ldp x18, x29, [sp, #144]
+    ldr x30, [sp, #160]
+    add sp, sp, #176
+    eret